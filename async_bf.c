@@ -1,20 +1,22 @@
-#define _BSD_SOURCE
 #include <stdio.h>
 #include <limits.h>
 #include <mpi.h>
 #include <string.h>
-#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "helpers.h"
 #include "benchmarks.h"
 #include "resultr.h"
-
-#define ITERATIONS_TO_CONVERGE 20
-
+#include "graph_mpi.h"
+#include "offers.h"
+#include "intvec.h"
 
 enum MPI_TAG {
-    TAG_KEY,
-    TAG_VAL
+    TAG_UPDATE,     // an Edge: our row n1 can get distance weight through n2
+    TAG_TOKEN,      // Safra's token: count and color
+    TAG_DONE        // rank 0 saw the token come back clean
 };
 
 static void pprintf(const char *fmt, ...) {
@@ -26,80 +28,55 @@ static void pprintf(const char *fmt, ...) {
     vprintf(fmt, args);
 }
 
-static int node_to_proc(int node, int nodes_per_proc) {
-    return (node / nodes_per_proc);
-}
-
-MQNode DUMMY = {-1, -1, -1};
-
-int async_bf(FlatMatrix *adj_matrix, int n_nodes, int n_edges, int src, WEIGHT *distances, int *next_hops);
+int async_bf(Graph *graph, Graph *in_graph, Partition *part, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *next_hops);
 
 int main(int argc, char **argv) {
 
     double start_wall, end_wall, cpu;
 
-    MPI_Init(&argc, &argv);
+    mpi_init_threads(&argc, &argv);
 
-    // arguments we need are the number of nodes and number of edges
-    if (argc != 4) {
-        printf("Usage: serial [n_nodes] [n_edges] [max_weight]\n");
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: serial [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
         exit(1);
     }
 
     debug_init();
 
-    int n_nodes = atoi(argv[1]);
-    unsigned long n_edges = atoi(argv[2]);
-    int max_weight = atoi(argv[3]);
-
-    FlatMatrix *adj_matrix;
     int rank, n_procs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
 
-    // master proc should split the graph up and distribute to each node
+    // no proc holds the whole graph: each one loads its own rows and gets the
+    // in edges of its own nodes from the others
     // also each proc should have their own version of distances[] and next_hops[]
 
-    // now we get our cluster.
-    // ASSUME that num_procs | n_nodes
-    int nodes_per_proc = n_nodes / n_procs;
-    // each node will have a matrix with nodes_per_proc rows and n_nodes cols
-    FlatMatrix *per_node_matrix = flat_matrix_init(n_nodes, nodes_per_proc);
     // global distances and global next_hops for gathering
     WEIGHT *global_distances = NULL;
     int *global_next_hops = NULL;
 
-    pprintf("About to have master generate stuff\n");
-    // the master proc will generate the graph
+    // master proc only needs room to gather the results
     if (rank == 0) {
         // allocate global distances and next_hops
         global_distances = calloc(n_nodes, sizeof(WEIGHT));
         global_next_hops = calloc(n_nodes, sizeof(int));
-
-
-        adj_matrix = gen_graph(n_nodes, n_edges, max_weight);
-        if (adj_matrix == NULL) {
-            exit(1);
-        }
-
-        //flat_matrix_print(adj_matrix);
-        /*for (int i = 0; i < n_nodes * n_nodes; i++) {*/
-            /*printf("%d ", adj_matrix->arr[i]);*/
-        /*}*/
-    } else {
-        adj_matrix = flat_matrix_init(n_nodes, n_nodes);
     }
 
-    // here we will just broadcast, since we need to know eaach node's neighbors in both directions
-    int bcast_res = MPI_Bcast(
-            adj_matrix->arr,
-            n_nodes * n_nodes,
-            MPI_INT,
-            0,
-            MPI_COMM_WORLD);
-    if (bcast_res) {
-        pprintf("Error when broadcasting!\n");
+    // we need to know each node's neighbors in both directions: the out edges
+    // are our own rows, the in edges come from everyone else's rows
+    Partition *part;
+    Graph *graph = graph_load_partitioned(graph_file, n_nodes, n_edges, max_weight, &part, MPI_COMM_WORLD);
+    if (graph == NULL) {
+        exit(1);
     }
+    Graph *in_graph = graph_in_edges(graph, part, MPI_COMM_WORLD);
+    // the engine only reads the in edges, through edge iterators, so pack them if asked
+    in_graph = graph_pack_if_asked(in_graph, MPI_COMM_WORLD);
 
     // function signatures should look like
     // int shortest_path(adj_matrix, n_nodes, source, WEIGHT *distances, int **paths)
@@ -112,13 +89,15 @@ int main(int argc, char **argv) {
     //print_array(adj_matrix, n_nodes);
 
     // each node has its own next_hops and distances arrays
-    int *async_bf_next_hops = calloc(nodes_per_proc, sizeof(int));
+    int *async_bf_next_hops = calloc(part->n_local ? part->n_local : 1, sizeof(int));
 
-    WEIGHT *async_bf_distances = calloc(nodes_per_proc, sizeof(WEIGHT));
+    WEIGHT *async_bf_distances = calloc(part->n_local ? part->n_local : 1, sizeof(WEIGHT));
 
 
     timing(&start_wall, &cpu);
-    async_bf(adj_matrix,
+    async_bf(graph,
+                    in_graph,
+                    part,
                     n_nodes,
                     n_edges,
                     0,
@@ -128,9 +107,9 @@ int main(int argc, char **argv) {
     timing(&end_wall, &cpu);
     pprintf("Async BF's time: %.4f\n", end_wall - start_wall);
 
-    // now we gather the results
-    MPI_Gather(async_bf_distances, nodes_per_proc, MPI_INT, global_distances, nodes_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Gather(async_bf_next_hops, nodes_per_proc, MPI_INT, global_next_hops, nodes_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
+    // now we gather the results back into global order
+    partition_gather(part, async_bf_distances, global_distances, MPI_WEIGHT, 0, MPI_COMM_WORLD);
+    partition_gather(part, async_bf_next_hops, global_next_hops, MPI_INT, 0, MPI_COMM_WORLD);
 
     // for comparison, get results from serial dijsktra
     if (rank == 0) {
@@ -176,223 +155,424 @@ int main(int argc, char **argv) {
     free(async_bf_distances);
     /*free(serial_distances);*/
     if (rank == 0) {
-        flat_matrix_free(adj_matrix);
         free(global_distances);
         free(global_next_hops);
     }
-    flat_matrix_free(per_node_matrix);
+    graph_free(graph);
+    graph_free(in_graph);
+    partition_free(part);
 
     MPI_Finalize();
 
     return 0;
 }
 
-int async_bf(FlatMatrix *adj_matrix, int n_nodes, int n_edges, int dest, WEIGHT *distances, int *next_hops) {
+// updates for one rank are held back until there are this many of them...
+#ifndef FLUSH_UPDATES
+#define FLUSH_UPDATES 1024
+#endif
+// ...or this many seconds went by since the last flush
+#ifndef FLUSH_SECONDS
+#define FLUSH_SECONDS 0.001
+#endif
+// batches in flight, each slot owns its buffer until its request completes
+#define SEND_SLOTS 64
+// receives kept posted for batches from anyone
+#define RECV_SLOTS 8
+// vertices relaxed per thread between looks at the inbox and the clock
+#define POLL_EVERY 256
+
+// everything a rank needs while it runs, so the message handlers can get at it
+typedef struct {
+    Partition *part;
+    int n_procs;
+    OfferTable *table;      // all changes to distances go through it
+    char *dirty;            // our nodes on the worklist
+    IntVec work;            // nodes to relax
+
+    // updates waiting to go to each rank. pending[n] is where global node n
+    // sits in its owner's buffer, or -1, so each target is in it at most
+    // once with the best distance offered so far
+    Edge **out;
+    int **out_nodes;        // the global ids of out[p]'s targets
+    int *n_out;
+    int *pending;
+    double last_flush;
+
+    Edge *send_bufs[SEND_SLOTS];
+    MPI_Request send_reqs[SEND_SLOTS];
+    int free_slots[SEND_SLOTS];
+    int n_free;
+    int completed[SEND_SLOTS];
+
+    // RECV_SLOTS batch receives, then the token and done receives
+    Edge *recv_bufs[RECV_SLOTS];
+    MPI_Request recv_reqs[RECV_SLOTS + 2];
+    long long token_buf[2];
+
+    long long count;        // batches sent minus batches received (Safra's c)
+    int black;              // received a batch since the token last passed
+    int have_token;
+    long long token[2];     // the token's count and color
+    int done;
+
+    unsigned long n_batches;
+    unsigned long n_updates;
+} AsyncState;
+
+// applies offers for our rows, the ones that get better go on the worklist
+static void apply_offers(AsyncState *s, Edge *offers, unsigned long n) {
+    offers_apply(s->table, offers, n);
+    for (long k = 0; k < s->table->n_improved; k++) {
+        int v = s->table->improved[k];
+        if (!s->dirty[v]) {
+            s->dirty[v] = 1;
+            vec_push(&s->work, v);
+        }
+    }
+}
 
-    // general workflow:
-    // If a node has n neighbors, then we essentially keep n "receives" open, one for each neighbor.
-    // Read those receives. If there is something in one of them, read it and reopen the receive
-    //  EAch receive essentially is an updated estimate. Then we recalculate our value and send() to all neighbors
-    // If we don't have an update in n loops, then we assume termiantion and just return.
-    //
-    // In general, each node waits for updates from their out_neighbors (downstream), and sends updates to their
-    // in_neighbors (upstream)
+static void post_recv(AsyncState *s, int i) {
+    if (i < RECV_SLOTS) {
+        MPI_Irecv(s->recv_bufs[i], FLUSH_UPDATES * sizeof(Edge), MPI_BYTE, MPI_ANY_SOURCE, TAG_UPDATE,
+                MPI_COMM_WORLD, &s->recv_reqs[i]);
+    } else if (i == RECV_SLOTS) {
+        MPI_Irecv(s->token_buf, 2, MPI_LONG_LONG, MPI_ANY_SOURCE, TAG_TOKEN, MPI_COMM_WORLD, &s->recv_reqs[i]);
+    } else {
+        MPI_Irecv(NULL, 0, MPI_BYTE, 0, TAG_DONE, MPI_COMM_WORLD, &s->recv_reqs[i]);
+    }
+}
 
-    // a dummy mpi_request
-    MPI_Request dummy_req;
+// handles a completed receive and reposts it
+static void handle(AsyncState *s, int i, MPI_Status *status) {
+    if (i < RECV_SLOTS) {
+        int bytes;
+        MPI_Get_count(status, MPI_BYTE, &bytes);
+        apply_offers(s, s->recv_bufs[i], bytes / sizeof(Edge));
+        s->count--;
+        s->black = 1;
+    } else if (i == RECV_SLOTS) {
+        s->token[0] = s->token_buf[0];
+        s->token[1] = s->token_buf[1];
+        s->have_token = 1;
+    } else {
+        s->done = 1;
+        return;
+    }
+    post_recv(s, i);
+}
 
-    int rank, n_procs;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
+// handles everything that has already arrived
+static void poll_messages(AsyncState *s) {
+    int n_done;
+    int idx[RECV_SLOTS + 2];
+    MPI_Status statuses[RECV_SLOTS + 2];
+    do {
+        MPI_Testsome(RECV_SLOTS + 2, s->recv_reqs, &n_done, idx, statuses);
+        for (int k = 0; k < n_done && n_done != MPI_UNDEFINED; k++) {
+            handle(s, idx[k], &statuses[k]);
+        }
+    } while (n_done > 0 && n_done != MPI_UNDEFINED && !s->done);
+}
 
-    // now we get our cluster.
-    // ASSUME that num_procs | n_nodes
-    int nodes_per_proc = n_nodes / n_procs;
-    int offset = nodes_per_proc * rank;
+static void reclaim_slots(AsyncState *s) {
+    int n_done;
+    MPI_Testsome(SEND_SLOTS, s->send_reqs, &n_done, s->completed, MPI_STATUSES_IGNORE);
+    for (int i = 0; i < n_done && n_done != MPI_UNDEFINED; i++) {
+        s->free_slots[s->n_free++] = s->completed[i];
+    }
+}
 
-    // whether we have a local update. Initially everyone does
-    int has_local_update = 1;
+// sends what we have for proc as one batch
+static void flush(AsyncState *s, int proc) {
+    int n = s->n_out[proc];
+    if (n == 0) {
+        return;
+    }
+    // keep taking messages while we wait for a slot, so two ranks flooding
+    // each other can't both get stuck here
+    while (s->n_free == 0) {
+        reclaim_slots(s);
+        poll_messages(s);
+    }
+    int slot = s->free_slots[--s->n_free];
+    // the buffers trade places, the slot's old one is free
+    Edge *batch = s->out[proc];
+    s->out[proc] = s->send_bufs[slot];
+    s->send_bufs[slot] = batch;
+    for (int k = 0; k < n; k++) {
+        s->pending[s->out_nodes[proc][k]] = -1;
+    }
+    s->n_out[proc] = 0;
+    MPI_Isend(batch, n * sizeof(Edge), MPI_BYTE, proc, TAG_UPDATE, MPI_COMM_WORLD, &s->send_reqs[slot]);
+    s->count++;
+    s->n_batches++;
+}
 
-    // initialize all the distances to infinity
-    for (int i = 0; i < nodes_per_proc; i++) {
-        if (offset + i == dest) {
-            pprintf("Initializing destination node %d\n", offset + i);
-            distances[i] = 0;
-            next_hops[i] = -1;
-        } else {
-            distances[i] = INT_MAX;
-            next_hops[i] = -1;
-        }
+static void flush_all(AsyncState *s) {
+    for (int p = 0; p < s->n_procs; p++) {
+        flush(s, p);
     }
+    s->last_flush = MPI_Wtime();
+}
 
-    int *n_in_neighbors = calloc(nodes_per_proc, sizeof(int));
-    int *n_out_neighbors = calloc(nodes_per_proc, sizeof(int));
-    for (int v = 0; v < nodes_per_proc; v++) {
-        // figure out how many neighbors each node has
-        // in neighbors of node v are at arr[i][v]
-        for (int i = 0; i < n_nodes; i++) {
-            // check if i is an in neighbor
-            if (flat_matrix_get(adj_matrix, i, v + offset)) {
-                n_in_neighbors[v]++;
-            }
-            if (flat_matrix_get(adj_matrix, v + offset, i)) {
-                n_out_neighbors[v]++;
-            }
+// queues the offer of distance d through via for global node n on proc
+static void send_update(AsyncState *s, int proc, int n, int via, WEIGHT d) {
+    int k = s->pending[n];
+    if (k != -1) {
+        // already going there, keep the better one
+        if (d < s->out[proc][k].weight) {
+            s->out[proc][k].n2 = via;
+            s->out[proc][k].weight = d;
         }
+        return;
     }
+    Edge update = {s->part->local_idx[n], via, d};
+    s->pending[n] = s->n_out[proc];
+    s->out_nodes[proc][s->n_out[proc]] = n;
+    s->out[proc][s->n_out[proc]++] = update;
+    s->n_updates++;
+    if (s->n_out[proc] == FLUSH_UPDATES) {
+        flush(s, proc);
+    }
+}
+// rank 0 starts a new round of the token: count 0, white
+static void start_token(AsyncState *s, int n_procs) {
+    long long token[2] = {0, 0};
+    s->black = 0;
+    MPI_Send(token, 2, MPI_LONG_LONG, 1 % n_procs, TAG_TOKEN, MPI_COMM_WORLD);
+}
 
-    // each node has global estimates
-    /*WEIGHT **estimates = calloc(nodes_per_proc, sizeof(WEIGHT *));*/
-
-
-    int **in_neighbors = calloc(nodes_per_proc, sizeof(int *));
-    int **out_neighbors = calloc(nodes_per_proc, sizeof(int *));
-
-    // for each node, we also need an array to store the active requests
-    MPI_Request **irecv_reqs = calloc(nodes_per_proc, sizeof(MPI_Request *));
-    MPI_Request **isend_reqs = calloc(nodes_per_proc, sizeof(MPI_Request *));
-
-    // for each node, we will also have a "new neighbor estimate array"
-    // that holds any updated estimates from OUT_NEIGHBORS
-    WEIGHT **downstream_updates = calloc(nodes_per_proc, sizeof(WEIGHT *));
-
+int async_bf(Graph *graph, Graph *in_graph, Partition *part, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
 
-    // now we get the actual list of neighbors
-    for (int v = 0; v < nodes_per_proc; v++) {
-        // allocate the list
-        in_neighbors[v] = calloc(n_in_neighbors[v], sizeof(int));
-        out_neighbors[v] = calloc(n_out_neighbors[v], sizeof(int));
-        downstream_updates[v] = calloc(n_out_neighbors[v], sizeof(WEIGHT));
+    // general workflow:
+    // A node that got better goes on the worklist, once. Relaxing it offers
+    // each of its in neighbors (upstream) its distance plus the edge. Offers
+    // to nodes on our proc are applied right away, the others are coalesced
+    // per destination proc, one entry per target with the best offer, and go
+    // out as a batch when a proc's buffer fills up, every FLUSH_SECONDS, or
+    // when we run out of work. Batches from anyone land in a few receives
+    // that are always posted. There are no rounds: every proc just works
+    // through its list and whatever the batches add to it.
+    //
+    // The OpenMP threads relax a slice of the worklist at a time, writing
+    // their offers to their own lists. Between slices the master thread
+    // coalesces the ones for other procs, applies ours through the
+    // OfferTable (see offers.h) with everyone's help, and does all the MPI.
+    //
+    // Termination is Safra's token ring. Each proc counts the batches it sent
+    // minus the ones it received, and turns black when it receives one. Once
+    // rank 0 runs out of work it sends a white token with count 0 around the
+    // ring. A proc only passes the token on when it has no work and nothing
+    // buffered, adding its count and blackening the token if it is black
+    // itself, then turns white. If the token comes back white with the counts
+    // summing to zero, no batch is in flight and nobody has work, so we are
+    // done; otherwise rank 0 tries again.
+    //
+    // In general, each node waits for updates from their out_neighbors (downstream), and sends updates to their
+    // in_neighbors (upstream)
 
-        irecv_reqs[v] = calloc(n_out_neighbors[v], sizeof(MPI_Request));
-        isend_reqs[v] = calloc(n_in_neighbors[v], sizeof(MPI_Request));
+    int rank, n_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
 
-        int in_idx = 0;
-        int out_idx = 0;
-        for (int i = 0; i < n_nodes; i++) {
-            // check if i is an in neighbor
-            if (flat_matrix_get(adj_matrix, i, v + offset)) {
-                in_neighbors[v][in_idx] = i;
-                isend_reqs[v][in_idx] = calloc(1, sizeof(MPI_Request));
-                in_idx++;
-            }
-            if (flat_matrix_get(adj_matrix, v + offset, i)) {
-                out_neighbors[v][out_idx] = i;
-                irecv_reqs[v][out_idx] = calloc(1, sizeof(MPI_Request));
-                out_idx++;
-            }
+    // our cluster: row v of the graph is global node part->local_nodes[v]
+    int n_local = part->n_local;
+
+    AsyncState *s = calloc(1, sizeof(AsyncState));
+    s->part = part;
+    s->n_procs = n_procs;
+    s->dirty = calloc(n_local ? n_local : 1, 1);
+    s->out = malloc(n_procs * sizeof(Edge *));
+    s->out_nodes = malloc(n_procs * sizeof(int *));
+    s->n_out = calloc(n_procs, sizeof(int));
+    for (int p = 0; p < n_procs; p++) {
+        s->out[p] = malloc(FLUSH_UPDATES * sizeof(Edge));
+        s->out_nodes[p] = malloc(FLUSH_UPDATES * sizeof(int));
+    }
+    s->pending = malloc(n_nodes * sizeof(int));
+    for (int n = 0; n < n_nodes; n++) {
+        s->pending[n] = -1;
+    }
+    for (int i = 0; i < SEND_SLOTS; i++) {
+        s->send_bufs[i] = malloc(FLUSH_UPDATES * sizeof(Edge));
+        s->send_reqs[i] = MPI_REQUEST_NULL;
+        s->free_slots[i] = i;
+    }
+    s->n_free = SEND_SLOTS;
+    for (int i = 0; i < RECV_SLOTS + 2; i++) {
+        if (i < RECV_SLOTS) {
+            s->recv_bufs[i] = malloc(FLUSH_UPDATES * sizeof(Edge));
         }
+        post_recv(s, i);
     }
+    s->last_flush = MPI_Wtime();
 
-    // always have the receive port open, for each neighbor of each node
-    // the message sent will be their new estimate for distance to the dest
-    for (int v = 0; v < nodes_per_proc; v++) {
-        for (int i = 0; i < n_out_neighbors[v]; i++) {
-            int n = out_neighbors[v][i];
-            int node = (n / nodes_per_proc);
-            MPI_Request req = irecv_reqs[v][i];
-            // n is the neighbor
-            // i is the index in out_neighbors
-
-            // alright the tag is gonna be given by
-            // sending from n to v
-            int tag = (v + offset) + n_nodes * n;
-            // updates from neighbor n to vertex v will go into downstream_updates[v][n];
-            MPI_Irecv(&(downstream_updates[v][i]), 1, MPI_INT, node, tag, MPI_COMM_WORLD, &req);
-        }
+    // initialize all the distances to infinity
+    for (int i = 0; i < n_local; i++) {
+        distances[i] = WEIGHT_MAX;
+        next_hops[i] = -1;
+    }
+    s->table = offers_init(n_local, distances, next_hops);
+    if (part->owner[dest] == rank) {
+        pprintf("Initializing destination node %d\n", dest);
+        Edge init = {part->local_idx[dest], -1, 0};
+        apply_offers(s, &init, 1);
     }
 
-    // now we can proceed
-    int static_iters = 0;
-    // while (static_iters < ITERATIONS_TO_CONVERGE) {
-    for (int n_iters = 0; n_iters < n_nodes; n_iters++) {
-        // check for any updates from downstream and
-        // use them to recompute local values
-        for (int v = 0; v < nodes_per_proc; v++) {
-            for (int i = 0; i < n_out_neighbors[v]; i++) {
-                int n = out_neighbors[v][i];
-                int proc = (n / nodes_per_proc);
-                // get the MPI_Request
-                MPI_Request req = irecv_reqs[v][i];
-
-                int flag;
-                MPI_Status status;
-                MPI_Test(&req, &flag, &status);
-
-                if (flag) {  // then we have an update
-
-                    // check the value of the downstream updates
-                    int new_est = downstream_updates[v][i];
-                    pprintf("Node %d got update from proc %d node %d (new_est %d)\n", v + offset, proc, n, new_est);
-                    int edge_weight = flat_matrix_get(adj_matrix, v + offset, n);
-                    if (new_est != INT_MAX && new_est + edge_weight < distances[v]) {
-                        distances[v] = new_est + edge_weight;
-                        next_hops[v] = n;
-                        has_local_update = 1;
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    long slice = (long) POLL_EVERY * n_threads;
+    // each thread's offers, then a slice's worth of them
+    OfferList *lists = calloc(n_threads, sizeof(OfferList));
+    OfferList offers = {NULL, NULL, 0, 0};
+
+    IntVec current = {NULL, 0, 0};
+    int token_out = 0;   // rank 0: a token is going around
+    unsigned long relaxed = 0;
+    while (!s->done) {
+        // take the worklist, relaxing refills s->work
+        IntVec swap = current;
+        current = s->work;
+        s->work = swap;
+        s->work.len = 0;
+
+        for (long lo = 0; lo < current.len; lo += slice) {
+            long hi = lo + slice < current.len ? lo + slice : current.len;
+            #pragma omp parallel
+            {
+                int t = 0;
+#ifdef _OPENMP
+                t = omp_get_thread_num();
+#endif
+                #pragma omp for schedule(dynamic, 16)
+                for (long i = lo; i < hi; i++) {
+                    int v = current.items[i];
+                    s->dirty[v] = 0;
+                    int via = part->local_nodes[v];
+                    EdgeIter it;
+                    graph_out_iter(in_graph, v, &it);
+                    int n;
+                    WEIGHT w;
+                    while (edge_iter_next(&it, &n, &w)) {
+                        WEIGHT alt_dist = weight_add(distances[v], w);
+                        if (alt_dist < WEIGHT_MAX) {
+                            // global id for now, send_update wants it
+                            offer_list_push(&lists[t], n, via, alt_dist, part->owner[n]);
+                        }
                     }
-
-                    // and now we reopen the irecv
-
-                    memset(&req, 0, sizeof(MPI_Request));
-                    int tag = (v + offset) + n_nodes * n;
-                    MPI_Irecv(&(downstream_updates[v][i]), 1, MPI_INT, proc, tag, MPI_COMM_WORLD, &req);
                 }
+            }
+            relaxed += hi - lo;
+            offer_list_merge(&offers, lists, n_threads);
+
+            // the other procs' offers get coalesced, ours are packed down
+            // to the front and applied
+            unsigned long n_mine = 0;
+            for (unsigned long k = 0; k < offers.len; k++) {
+                Edge *o = &offers.edges[k];
+                if (offers.dests[k] != rank) {
+                    send_update(s, offers.dests[k], o->n1, o->n2, o->weight);
+                    continue;
+                }
+                Edge mine = {part->local_idx[o->n1], o->n2, o->weight};
+                offers.edges[n_mine++] = mine;
+            }
+            offers.len = 0;
+            apply_offers(s, offers.edges, n_mine);
 
+            poll_messages(s);
+            reclaim_slots(s);
+            if (MPI_Wtime() - s->last_flush > FLUSH_SECONDS) {
+                flush_all(s);
             }
+        }
+        if (s->work.len > 0) {
+            continue;
+        }
 
-            if (has_local_update) {
-                static_iters = 0;
-                for (int i = 0; i < n_in_neighbors[v]; i++) {
-                    MPI_Request req = isend_reqs[v][i];
-                    int n = in_neighbors[v][i];
-                    int proc = (n / nodes_per_proc);
-                    int tag = (v + offset) * n_nodes + n;
-                    pprintf("Node %d sending updated estimate %d to proc %d\n", v + offset, distances[v], proc);
-
-                    int flag;
-                    MPI_Status status;
-                    MPI_Request_get_status(req, &flag, &status);
-                    if (!flag) pprintf("Past send not complete!\n");
-
-                    MPI_Isend(&distances[v], 1, MPI_INT, proc, tag, MPI_COMM_WORLD, &req);
+        // no work left here for now, so whatever we're holding goes out
+        flush_all(s);
+        reclaim_slots(s);
+        poll_messages(s);
+        if (s->done) {
+            break;
+        }
+        if (s->work.len > 0) {
+            continue;
+        }
+
+        if (rank == 0) {
+            if (n_procs == 1) {
+                break;
+            }
+            if (s->have_token) {
+                s->have_token = 0;
+                token_out = 0;
+                if (!s->token[1] && !s->black && s->token[0] + s->count == 0) {
+                    for (int p = 1; p < n_procs; p++) {
+                        MPI_Send(NULL, 0, MPI_BYTE, p, TAG_DONE, MPI_COMM_WORLD);
+                    }
+                    break;
                 }
-                has_local_update = 0;
-            } else {
-                static_iters++;
             }
-
+            if (!token_out) {
+                start_token(s, n_procs);
+                token_out = 1;
+            }
+        } else if (s->have_token) {
+            long long token[2] = {s->token[0] + s->count, s->token[1] || s->black};
+            s->have_token = 0;
+            s->black = 0;
+            MPI_Send(token, 2, MPI_LONG_LONG, (rank + 1) % n_procs, TAG_TOKEN, MPI_COMM_WORLD);
         }
 
-        usleep(100000);
-        MPI_Barrier(MPI_COMM_WORLD);
+        // nothing to do until a message shows up
+        int i;
+        MPI_Status status;
+        MPI_Waitany(RECV_SLOTS + 2, s->recv_reqs, &i, &status);
+        handle(s, i, &status);
     }
 
-    // then we put a barrier here to make sure everyone returns at the same time
-    /*MPI_Barrier(MPI_COMM_WORLD);*/
+    // everything we sent has been received by now, so the receives still
+    // posted will never match anything
+    MPI_Waitall(SEND_SLOTS, s->send_reqs, MPI_STATUSES_IGNORE);
+    for (int i = 0; i < RECV_SLOTS + 2; i++) {
+        if (s->recv_reqs[i] != MPI_REQUEST_NULL) {
+            MPI_Cancel(&s->recv_reqs[i]);
+            MPI_Wait(&s->recv_reqs[i], MPI_STATUS_IGNORE);
+        }
+    }
+    debugf("relaxed %lu nodes, sent %lu updates in %lu batches\n", relaxed, s->n_updates, s->n_batches);
 
     //////////////////////////////////////////////////////////////
     // CLEANUP
     //////////////////////////////////////////////////////////////
-
-    for (int i = 0; i < nodes_per_proc; i++) {
-        free(in_neighbors[i]);
-        free(out_neighbors[i]);
-        free(downstream_updates[i]);
-        for (int j = 0; j < n_out_neighbors[i]; j++) {
-            free(irecv_reqs[i][j]);
-        }
-        for (int j = 0; j < n_in_neighbors[i]; j++) {
-            free(isend_reqs[i][j]);
-        }
-        free(irecv_reqs[i]);
-        free(isend_reqs[i]);
+    for (int p = 0; p < n_procs; p++) {
+        free(s->out[p]);
+        free(s->out_nodes[p]);
     }
-    free(in_neighbors);
-    free(out_neighbors);
-    free(downstream_updates);
-    free(irecv_reqs);
-    free(isend_reqs);
-    free(n_in_neighbors);
-    free(n_out_neighbors);
-
+    for (int i = 0; i < SEND_SLOTS; i++) {
+        free(s->send_bufs[i]);
+    }
+    for (int i = 0; i < RECV_SLOTS; i++) {
+        free(s->recv_bufs[i]);
+    }
+    for (int t = 0; t < n_threads; t++) {
+        offer_list_free(&lists[t]);
+    }
+    free(lists);
+    offer_list_free(&offers);
+    offers_free(s->table);
+    free(s->out);
+    free(s->out_nodes);
+    free(s->n_out);
+    free(s->pending);
+    free(s->dirty);
+    free(s->work.items);
+    free(current.items);
+    free(s);
+    return 0;
 }
@@ -1,41 +1,53 @@
 #include "benchmarks.h"
+#include "bf_kernel.h"
+
+// one int per bucket, so past this dial's buckets stop fitting in cache
+#define DIAL_MAX_BUCKETS (1 << 24)
 
 // returns 0 on success, -1 on failure for whatever reason.
-int serial_dijkstra(FlatMatrix *adj_matrix, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
-    // first we need a distance vector type thing
-    MQNode **mqns = malloc(n_nodes * sizeof(MQNode)); // oh boy
-    distances[dest] = 0;
+int serial_dijkstra(Graph *graph, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    // we relax the in neighbors of each popped node, which the reverse index has contiguously
+    graph_build_reverse(graph);
 
-    MinQueue *mq = mqueue_init(n_nodes);
+    // the queue is picked by QUEUE (see min_queue.h). The bucket queues are
+    // monotone, so vertices only go in once they're reached instead of all
+    // starting out at infinity
+    MQUEUE_KIND kind = mqueue_kind_from_env();
+    WEIGHT max_weight = kind == MQUEUE_DIAL ? graph_max_weight(graph) : 0;
+    if (max_weight > DIAL_MAX_BUCKETS) {
+        printf("WARNING: max weight %" WEIGHT_FMT " is too big for dial, using radix\n", max_weight);
+        kind = MQUEUE_RADIX;
+    }
+    MinQueue *mq = mqueue_init_kind(kind, n_nodes, max_weight);
 
-    // initialize all of the distances into the min queue
     for (int v = 0; v < n_nodes; v++) {
-        if (v != dest) {
-            distances[v] = INT_MAX;  // doesn't feel too kosher but we're going with it
-        }
+        distances[v] = WEIGHT_MAX;  // doesn't feel too kosher but we're going with it
         next_hops[v] = -1;
-        MQNode *mqn = malloc(sizeof(MQNode));
-        mqns[v] = mqn;
-        mqn->key = v;
-        mqn->val = distances[v];
-        mqueue_insert(mq, mqn);
     }
+    distances[dest] = 0;
+    mqueue_push(mq, dest, 0);
 
-    while (!mqueue_is_empty(mq)) {
-        MQNode *mqn = mqueue_pop_min(mq);
-        int v = mqn->key;
-        debugf("Popped node %d with distance %d\n", v, distances[v]);
-        for (int n = 0; n < n_nodes; n++) { // iterate through each in neighbor of this node
-            if (!flat_matrix_get(adj_matrix, n, v)) {
-                continue;
-            }
-            WEIGHT alt_dist = distances[v] + flat_matrix_get(adj_matrix, n, v);
-            debugf("For node %d, alt_dist %ld, distances %d, adj_matrix %d\n", n, alt_dist, distances[n], flat_matrix_get(adj_matrix, n, v));
-            if (distances[v] != INT_MAX && alt_dist < distances[n]) {
-                distances[n] = (WEIGHT) alt_dist;
+    int v;
+    while (mqueue_pop(mq, &v, NULL)) {
+        debugf("Popped node %d with distance %" WEIGHT_FMT "\n", v, distances[v]);
+        EdgeIter it;
+        graph_in_iter(graph, v, &it);
+        int n;
+        WEIGHT w;
+        while (edge_iter_next(&it, &n, &w)) { // iterate through each in neighbor of this node
+            // saturates, so an unreachable v never beats anything
+            WEIGHT alt_dist = weight_add(distances[v], w);
+            debugf("For node %d, alt_dist %" WEIGHT_FMT ", distances %" WEIGHT_FMT ", weight %" WEIGHT_FMT "\n",
+                    n, alt_dist, distances[n], w);
+            if (alt_dist < distances[n]) {
+                distances[n] = alt_dist;
                 next_hops[n] = v;
-                debugf("Updating node %d distance to %d\n", n, alt_dist);
-                mqueue_update_val(mq, mqns[n], alt_dist);
+                debugf("Updating node %d distance to %" WEIGHT_FMT "\n", n, alt_dist);
+                if (mqueue_contains(mq, n)) {
+                    mqueue_update_key(mq, n, alt_dist);
+                } else {
+                    mqueue_push(mq, n, alt_dist);
+                }
             }
         }
     }
@@ -43,71 +55,226 @@ int serial_dijkstra(FlatMatrix *adj_matrix, int n_nodes, unsigned long n_edges,
     ///////////////////////////////////////////////////////////////////
     // CLEAN UP
     ///////////////////////////////////////////////////////////////////
-    mqueue_free(mq, 0);
-    for (int i = 0; i < n_nodes; i++) {
-        free(mqns[i]);
-    }
-    free(mqns);
+    mqueue_free(mq);
     return 0;
 }
 
 // returns 0 on success, -1 on failure for whatever reason.
-int serial_bellman_ford(FlatMatrix *adj_matrix, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
-    // preprocess once to convert adjacency matrix to edge list
-    typedef struct {
-        int n1;
-        int n2;
-        WEIGHT weight;
-    } Edge;
-
-    // each edj struct is a directed edge from n1 to n2
-    Edge *edges= calloc(n_edges, sizeof(Edge));
-
-    int e_i = 0;
-    for (int i = 0; i < n_nodes; i++) {
-        for (int j = 0; j < n_nodes; j++) {
-            if (flat_matrix_get(adj_matrix, i, j)) {
-                Edge e = {i, j, flat_matrix_get(adj_matrix, i, j)};
-                edges[e_i++] = e;
+int serial_dijkstra_lazy(Graph *graph, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    graph_build_reverse(graph);
+
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = WEIGHT_MAX;
+        next_hops[v] = -1;
+    }
+    distances[dest] = 0;
+
+    // a vertex can be in here several times, only the entry matching its
+    // current distance is live
+    EntryHeap *h = eheap_init(n_nodes < 1024 ? n_nodes : 1024);
+    eheap_push(h, dest, 0);
+
+    int v;
+    WEIGHT d;
+    while (eheap_pop(h, &v, &d)) {
+        if (d > distances[v]) {
+            continue; // stale, v was settled with something smaller already
+        }
+        debugf("Popped node %d with distance %" WEIGHT_FMT "\n", v, d);
+        EdgeIter it;
+        graph_in_iter(graph, v, &it);
+        int n;
+        WEIGHT w;
+        while (edge_iter_next(&it, &n, &w)) {
+            WEIGHT alt_dist = weight_add(d, w);
+            if (alt_dist < distances[n]) {
+                distances[n] = alt_dist;
+                next_hops[n] = v;
+                eheap_push(h, n, alt_dist);
             }
         }
     }
 
+    eheap_free(h);
+    return 0;
+}
 
-    // now that we have the edge list...
+// returns 0 on success, -1 on failure for whatever reason.
+int serial_bellman_ford(Graph *graph, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    // the csr rows already are an edge list grouped by source, so no preprocessing
     for (int i = 0; i < n_nodes; i++) {
-        distances[i] = INT_MAX;
+        distances[i] = WEIGHT_MAX;
         next_hops[i] = -1;
     }
 
     distances[dest] = 0;
 
-    for (int n = 0; n < n_nodes; n++){
-        for (unsigned long e = 0; e < n_edges; e++) {
-            // edge from u to v
-            int u = edges[e].n1;
-            int v = edges[e].n2;
-            WEIGHT w = edges[e].weight;
-            // check if u can go through v instead
-            debugf("Checking for a path from node %d through node %d\n", u, v);
-            debugf("distances[%d}: %d distances[%d]: %d\n", u, distances[u], v, distances[v]);
-            if (distances[v] != INT_MAX && distances[v] + w < distances[u]) {
-                debugf("Found! Old distances[%d]: %d. New: %d\n", u, distances[u], distances[v] + w);
-                distances[u] = distances[v] + w;
-                next_hops[u] = v;
+    // n_nodes - 1 passes is the worst case, but a pass that changes nothing
+    // means the next one wouldn't either, so stop there. Anything still
+    // changing on pass n_nodes is going around a negative cycle
+    BF_KERNEL kernel = bf_kernel_pick();
+    int rounds = 0;
+    int changed = 1;
+    while (changed && rounds < n_nodes) {
+        rounds++;
+        // u can go through v for every edge u -> v, see bf_kernel.c
+        changed = bf_relax_rows(kernel, graph, 0, n_nodes, distances, next_hops);
+    }
+
+    return changed ? -1 : rounds;
+}
+
+int serial_bellman_ford_queue(Graph *graph, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    // the vertices that changed are the only ones whose in neighbors can
+    // get better, so those are what the queue holds. A vertex is in it at
+    // most once, so n_nodes slots around a ring are enough
+    graph_build_reverse(graph);
+
+    int *queue = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    char *queued = calloc(n_nodes ? n_nodes : 1, 1);
+    // edges on the path to dest. A shortest path has fewer than n_nodes, so
+    // reaching that means the path goes around a negative cycle
+    int *hops = calloc(n_nodes ? n_nodes : 1, sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = WEIGHT_MAX;
+        next_hops[v] = -1;
+    }
+    distances[dest] = 0;
+    queue[0] = dest;
+    queued[dest] = 1;
+    int head = 0;
+    int n_queued = 1;
+
+    int pops = 0;
+    int cycle = 0;
+    while (n_queued > 0 && !cycle) {
+        int v = queue[head];
+        head = (head + 1) % n_nodes;
+        n_queued--;
+        queued[v] = 0;
+        pops++;
+
+        EdgeIter it;
+        graph_in_iter(graph, v, &it);
+        int n;
+        WEIGHT w;
+        while (edge_iter_next(&it, &n, &w)) {
+            WEIGHT alt_dist = weight_add(distances[v], w);
+            if (alt_dist < distances[n]) {
+                distances[n] = alt_dist;
+                next_hops[n] = v;
+                hops[n] = hops[v] + 1;
+                if (hops[n] >= n_nodes) {
+                    cycle = 1;
+                    break;
+                }
+                if (!queued[n]) {
+                    queued[n] = 1;
+                    queue[(head + n_queued) % n_nodes] = n;
+                    n_queued++;
+                }
             }
         }
     }
 
+    free(queue);
+    free(queued);
+    free(hops);
+    return cycle ? -1 : pops;
+}
 
-    ////////////////////////////////////////////////////////////////////////////////
-    // CLEAN UP
-    ////////////////////////////////////////////////////////////////////////////////
-    free(edges);
+int serial_bellman_ford_yen(Graph *graph, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    // every row is copied with its edges to lower (or equal) ids first. The
+    // forward pass goes up through the vertices using only those, so a
+    // change to v is seen by every higher u in the same pass, and the
+    // backward pass goes down using the rest. Any path is a run of steps
+    // down then up then down..., and each pair of passes gets through one
+    // down run and one up run, so n_nodes / 2 + 1 pairs are enough
+    unsigned long *offsets = malloc((n_nodes + 1) * sizeof(unsigned long));
+    unsigned long *split = malloc((n_nodes ? n_nodes : 1) * sizeof(unsigned long));
+    int *targets = malloc((graph->n_edges ? graph->n_edges : 1) * sizeof(int));
+    WEIGHT *weights = malloc((graph->n_edges ? graph->n_edges : 1) * sizeof(WEIGHT));
+    unsigned long next = 0;
+    for (int u = 0; u < n_nodes; u++) {
+        offsets[u] = next;
+        for (int pass = 0; pass < 2; pass++) {
+            EdgeIter it;
+            graph_out_iter(graph, u, &it);
+            int v;
+            WEIGHT w;
+            while (edge_iter_next(&it, &v, &w)) {
+                if ((v > u) == pass) {
+                    targets[next] = v;
+                    weights[next++] = w;
+                }
+            }
+            if (pass == 0) {
+                split[u] = next;
+            }
+        }
+    }
+    offsets[n_nodes] = next;
 
-    return 0;
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = WEIGHT_MAX;
+        next_hops[v] = -1;
+    }
+    distances[dest] = 0;
+
+    int pairs = 0;
+    int changed = 1;
+    while (changed && pairs <= n_nodes / 2 + 1) {
+        changed = 0;
+        pairs++;
+        for (int u = 0; u < n_nodes; u++) {
+            for (unsigned long e = offsets[u]; e < split[u]; e++) {
+                WEIGHT alt_dist = weight_add(distances[targets[e]], weights[e]);
+                if (alt_dist < distances[u]) {
+                    distances[u] = alt_dist;
+                    next_hops[u] = targets[e];
+                    changed = 1;
+                }
+            }
+        }
+        for (int u = n_nodes - 1; u >= 0; u--) {
+            for (unsigned long e = split[u]; e < offsets[u + 1]; e++) {
+                WEIGHT alt_dist = weight_add(distances[targets[e]], weights[e]);
+                if (alt_dist < distances[u]) {
+                    distances[u] = alt_dist;
+                    next_hops[u] = targets[e];
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    free(offsets);
+    free(split);
+    free(targets);
+    free(weights);
+    return changed ? -1 : pairs;
 }
 
+void recompute_next_hops(Graph *graph, int n_nodes, int src, WEIGHT *distances, int *next_hops) {
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int u = 0; u < n_nodes; u++) {
+        next_hops[u] = -1;
+        if (u == src || distances[u] == WEIGHT_MAX) {
+            continue;
+        }
+        EdgeIter it;
+        graph_out_iter(graph, u, &it);
+        int v;
+        WEIGHT w;
+        while (edge_iter_next(&it, &v, &w)) {
+            // saturates, so an unreachable v never matches
+            if (weight_add(distances[v], w) == distances[u]) {
+                next_hops[u] = v;
+                break;
+            }
+        }
+    }
+}
 
 void print_path(int *next_hops, int idx) {
     while (idx != -1) {
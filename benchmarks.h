@@ -7,8 +7,30 @@
 #include "helpers.h"
 #include "min_queue.h"
 #include "flat_matrix.h"
+#include "graph.h"
 
-int serial_dijkstra(FlatMatrix *adj_matrix, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
-int serial_bellman_ford(FlatMatrix *adj_matrix, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
+int serial_dijkstra(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
+// Dijkstra without decrease-key: every improvement pushes a new entry and
+// the stale ones are skipped when they're popped
+int serial_dijkstra_lazy(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
+// The Bellman-Ford engines take negative weights, and return -1 if there is
+// a negative cycle on the way to src.
+// returns the number of passes it took, the last one being the pass that
+// changed nothing
+int serial_bellman_ford(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
+// worklist version (SPFA): only relaxes around vertices whose distance just
+// changed. Returns how many times a vertex came off the queue. Stops as soon
+// as a path gets n_nodes edges long
+int serial_bellman_ford_queue(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
+// Yen's ordering: alternates a pass up through the vertices over the edges
+// to lower ids with a pass down over the edges to higher ids. Returns the
+// number of pass pairs
+int serial_bellman_ford_yen(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *predecessors);
+
+// for the engines that lower distances with atomics: the distance and hop of
+// a vertex can't be written together atomically, so the hops are worked out
+// once the distances are final, as any out neighbor the shortest path can go
+// through. Runs over the vertices with OpenMP
+void recompute_next_hops(Graph *graph, int n_nodes, int src, WEIGHT *distances, int *next_hops);
 
 #endif
@@ -0,0 +1,193 @@
+#include <string.h>
+
+#include "bf_kernel.h"
+
+// the vector kernels are for 32-bit distances on x86 compilers that can
+// target a cpu feature per function, everything else only has scalar
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(WEIGHT_64)
+#define BF_SIMD
+#include <immintrin.h>
+#endif
+
+static const char *KERNEL_NAMES[] = {"scalar", "avx2", "avx512"};
+
+static int kernel_supported(BF_KERNEL kernel) {
+#ifdef BF_SIMD
+    __builtin_cpu_init();
+    if (kernel == BF_KERNEL_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (kernel == BF_KERNEL_AVX512) {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+    return kernel == BF_KERNEL_SCALAR;
+}
+
+BF_KERNEL bf_kernel_pick() {
+    BF_KERNEL best = BF_KERNEL_SCALAR;
+    for (int k = BF_KERNEL_SCALAR; k < N_BF_KERNELS; k++) {
+        if (kernel_supported(k)) {
+            best = k;
+        }
+    }
+    char *name = getenv("BF_KERNEL");
+    if (name == NULL) {
+        return best;
+    }
+    for (int k = BF_KERNEL_SCALAR; k < N_BF_KERNELS; k++) {
+        if (strcmp(name, KERNEL_NAMES[k]) == 0) {
+            if (kernel_supported(k)) {
+                return k;
+            }
+            printf("WARNING: BF_KERNEL %s isn't supported here, using %s\n", name, KERNEL_NAMES[best]);
+            return best;
+        }
+    }
+    printf("WARNING: unknown BF_KERNEL %s, using %s\n", name, KERNEL_NAMES[best]);
+    return best;
+}
+
+const char *bf_kernel_name(BF_KERNEL kernel) {
+    return KERNEL_NAMES[kernel];
+}
+
+// threads can sweep disjoint row ranges of the same distances at once (see
+// omp_bf.c): a thread only writes its own rows, but reads anybody's. So
+// distances are loaded and stored with relaxed atomics, which on the cpus we
+// run on are the plain moves they replace. The gathers below read each lane
+// with one aligned 32-bit load, which is as much as a relaxed load promises
+static int relax_scalar(Graph *g, int lo, int hi, WEIGHT *distances, int *next_hops) {
+    int changed = 0;
+    for (int u = lo; u < hi; u++) {
+        WEIGHT old = __atomic_load_n(&distances[u], __ATOMIC_RELAXED);
+        WEIGHT best = old;
+        EdgeIter it;
+        graph_out_iter(g, u, &it);
+        int v;
+        WEIGHT w;
+        while (edge_iter_next(&it, &v, &w)) {
+            WEIGHT alt_dist = weight_add(__atomic_load_n(&distances[v], __ATOMIC_RELAXED), w);
+            if (alt_dist < best) {
+                best = alt_dist;
+                next_hops[u] = v;
+            }
+        }
+        if (best < old) {
+            __atomic_store_n(&distances[u], best, __ATOMIC_RELAXED);
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+#ifdef BF_SIMD
+
+// a vector kernel found min_dist < distances[u]; the first edge giving it
+// is the one the scalar kernel would have kept
+static void take_min(Graph *g, int u, WEIGHT min_dist, WEIGHT *distances, int *next_hops) {
+    for (unsigned long e = g->offsets[u]; e < g->offsets[u + 1]; e++) {
+        if (weight_add(__atomic_load_n(&distances[g->targets[e]], __ATOMIC_RELAXED), g->weights[e]) == min_dist) {
+            next_hops[u] = g->targets[e];
+            break;
+        }
+    }
+    __atomic_store_n(&distances[u], min_dist, __ATOMIC_RELAXED);
+}
+
+// rows this short aren't worth a vector
+#define SIMD_MIN_DEGREE 4
+
+__attribute__((target("avx2")))
+static int relax_avx2(Graph *g, int lo, int hi, WEIGHT *distances, int *next_hops) {
+    const __m256i max = _mm256_set1_epi32(WEIGHT_MAX);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int changed = 0;
+    for (int u = lo; u < hi; u++) {
+        unsigned long start = g->offsets[u];
+        unsigned long end = g->offsets[u + 1];
+        if (end - start < SIMD_MIN_DEGREE) {
+            changed |= relax_scalar(g, u, u + 1, distances, next_hops);
+            continue;
+        }
+        __m256i best = max;
+        for (unsigned long e = start; e < end; e += 8) {
+            __m256i t, w, d;
+            if (end - e >= 8) {
+                t = _mm256_loadu_si256((const __m256i *) (g->targets + e));
+                w = _mm256_loadu_si256((const __m256i *) (g->weights + e));
+                d = _mm256_i32gather_epi32(distances, t, 4);
+            } else {
+                // the row's tail: lanes past the end read nothing and count as unreachable
+                __m256i live = _mm256_cmpgt_epi32(_mm256_set1_epi32((int) (end - e)), lanes);
+                t = _mm256_maskload_epi32(g->targets + e, live);
+                w = _mm256_maskload_epi32(g->weights + e, live);
+                d = _mm256_mask_i32gather_epi32(max, distances, t, live, 4);
+            }
+            __m256i sum = _mm256_add_epi32(d, w);
+            // saturate like weight_add: unreachable stays unreachable, and a
+            // positive weight that wrapped around goes to WEIGHT_MAX
+            __m256i bad = _mm256_or_si256(_mm256_cmpeq_epi32(d, max),
+                    _mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(d, sum)));
+            best = _mm256_min_epi32(best, _mm256_blendv_epi8(sum, max, bad));
+        }
+        __m128i m = _mm_min_epi32(_mm256_castsi256_si128(best), _mm256_extracti128_si256(best, 1));
+        m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+        WEIGHT min_dist = _mm_cvtsi128_si32(m);
+        if (min_dist < __atomic_load_n(&distances[u], __ATOMIC_RELAXED)) {
+            take_min(g, u, min_dist, distances, next_hops);
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+__attribute__((target("avx512f")))
+static int relax_avx512(Graph *g, int lo, int hi, WEIGHT *distances, int *next_hops) {
+    const __m512i max = _mm512_set1_epi32(WEIGHT_MAX);
+    const __m512i zero = _mm512_setzero_si512();
+    int changed = 0;
+    for (int u = lo; u < hi; u++) {
+        unsigned long start = g->offsets[u];
+        unsigned long end = g->offsets[u + 1];
+        if (end - start < SIMD_MIN_DEGREE) {
+            changed |= relax_scalar(g, u, u + 1, distances, next_hops);
+            continue;
+        }
+        __m512i best = max;
+        for (unsigned long e = start; e < end; e += 16) {
+            __mmask16 live = end - e >= 16 ? 0xffff : (__mmask16) ((1u << (end - e)) - 1);
+            __m512i t = _mm512_maskz_loadu_epi32(live, g->targets + e);
+            __m512i w = _mm512_maskz_loadu_epi32(live, g->weights + e);
+            __m512i d = _mm512_mask_i32gather_epi32(max, live, t, distances, 4);
+            __m512i sum = _mm512_add_epi32(d, w);
+            __mmask16 bad = _mm512_cmpeq_epi32_mask(d, max)
+                    | (_mm512_cmpgt_epi32_mask(w, zero) & _mm512_cmpgt_epi32_mask(d, sum));
+            best = _mm512_min_epi32(best, _mm512_mask_mov_epi32(sum, bad, max));
+        }
+        WEIGHT min_dist = _mm512_reduce_min_epi32(best);
+        if (min_dist < __atomic_load_n(&distances[u], __ATOMIC_RELAXED)) {
+            take_min(g, u, min_dist, distances, next_hops);
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+#endif
+
+int bf_relax_rows(BF_KERNEL kernel, Graph *g, int lo, int hi, WEIGHT *distances, int *next_hops) {
+#ifdef BF_SIMD
+    if (g->packed == NULL) {
+        if (kernel == BF_KERNEL_AVX512) {
+            return relax_avx512(g, lo, hi, distances, next_hops);
+        }
+        if (kernel == BF_KERNEL_AVX2) {
+            return relax_avx2(g, lo, hi, distances, next_hops);
+        }
+    }
+#endif
+    return relax_scalar(g, lo, hi, distances, next_hops);
+}
@@ -0,0 +1,31 @@
+#ifndef __BF_KERNEL_H__
+#define __BF_KERNEL_H__
+
+#include "graph.h"
+
+// the relaxation sweep at the heart of serial_bellman_ford. The csr rows
+// already are a structure of arrays grouped by source, so every edge of a
+// row writes the same distances[u]: the SIMD kernels gather distances[v] for
+// a vector of edges, add the weights with saturation and min-reduce the
+// lanes, with no conflicts to resolve. The kernel is picked at run time from
+// what the cpu supports
+typedef enum {
+    BF_KERNEL_SCALAR,
+    BF_KERNEL_AVX2,
+    BF_KERNEL_AVX512,
+    N_BF_KERNELS
+} BF_KERNEL;
+
+// the best kernel this cpu (and build) can run. The BF_KERNEL environment
+// variable (scalar, avx2 or avx512) asks for a specific one
+BF_KERNEL bf_kernel_pick();
+const char *bf_kernel_name(BF_KERNEL kernel);
+
+// one pass over rows [lo, hi): distances[u] = min(distances[u],
+// distances[v] + w) for every edge u -> v, in row order so later rows see
+// earlier updates. Returns 1 if any distance changed. Threads can run it on
+// disjoint row ranges of the same distances at once. Packed graphs and
+// 64-bit distances always go through the scalar kernel
+int bf_relax_rows(BF_KERNEL kernel, Graph *g, int lo, int hi, WEIGHT *distances, int *next_hops);
+
+#endif
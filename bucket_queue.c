@@ -0,0 +1,193 @@
+// monotone integer priority queues. Both keep every key in a doubly linked
+// list for its bucket, with the links in arrays indexed by key, so pushes,
+// updates and removals from the middle of a bucket are O(1) and nothing is
+// allocated per item.
+//
+// radix: bucket 0 holds the keys whose value equals last (the last popped
+// value), bucket b > 0 the ones whose value first differs from last in bit
+// b - 1. Popping from an empty bucket 0 finds the first non-empty bucket,
+// makes its smallest value the new last and spreads that bucket over the
+// buckets below it. A key only ever moves to lower buckets, so each one is
+// touched O(log C) times.
+//
+// dial: values in the queue are always within [last, last + max_weight], so
+// max_weight + 1 buckets indexed by value mod that many never collide. The
+// cursor walks around them in order.
+#include "bucket_queue.h"
+
+static int radix_bucket(WEIGHT last, WEIGHT val) {
+    unsigned long long diff = (unsigned long long) last ^ (unsigned long long) val;
+    if (diff == 0) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(diff);
+}
+
+static int bucket_for(MinQueue *mq, WEIGHT val) {
+    if (mq->kind == MQUEUE_RADIX) {
+        return radix_bucket(mq->last, val);
+    }
+    return (int) (val % mq->n_buckets);
+}
+
+static void list_push(MinQueue *mq, int b, int key) {
+    MQLink *l = &mq->links[key];
+    l->bucket = b;
+    l->prev = -1;
+    l->next = mq->heads[b];
+    if (l->next != -1) {
+        mq->links[l->next].prev = key;
+    }
+    mq->heads[b] = key;
+}
+
+static void list_remove(MinQueue *mq, int key) {
+    MQLink *l = &mq->links[key];
+    if (l->prev != -1) {
+        mq->links[l->prev].next = l->next;
+    } else {
+        mq->heads[l->bucket] = l->next;
+    }
+    if (l->next != -1) {
+        mq->links[l->next].prev = l->prev;
+    }
+    l->bucket = -1;
+}
+
+static void alloc_keys(MinQueue *mq, int from, int to) {
+    mq->links = realloc(mq->links, to * sizeof(MQLink));
+    for (int k = from; k < to; k++) {
+        mq->links[k].bucket = -1;
+    }
+}
+
+void bucket_init(MinQueue *mq, WEIGHT max_weight) {
+    if (mq->kind == MQUEUE_RADIX) {
+        mq->n_buckets = 65;
+    } else {
+        mq->n_buckets = (int) max_weight + 1;
+    }
+    mq->heads = malloc(mq->n_buckets * sizeof(int));
+    for (int b = 0; b < mq->n_buckets; b++) {
+        mq->heads[b] = -1;
+    }
+    mq->links = NULL;
+    alloc_keys(mq, 0, mq->key_range);
+    mq->last = 0;
+    mq->cursor = 0;
+}
+
+void bucket_clear(MinQueue *mq) {
+    for (int b = 0; b < mq->n_buckets; b++) {
+        for (int k = mq->heads[b]; k != -1; k = mq->links[k].next) {
+            mq->links[k].bucket = -1;
+        }
+        mq->heads[b] = -1;
+    }
+    mq->n_items = 0;
+    mq->last = 0;
+    mq->cursor = 0;
+}
+
+int bucket_contains(MinQueue *mq, int key) {
+    return key >= 0 && key < mq->key_range && mq->links[key].bucket != -1;
+}
+
+int bucket_push(MinQueue *mq, int key, WEIGHT val) {
+    if (mq->n_items == mq->capacity || key < 0 || bucket_contains(mq, key) || val < mq->last) {
+        return -1;
+    }
+    if (key >= mq->key_range) {
+        int range = mq->key_range;
+        while (range <= key) {
+            range *= 2;
+        }
+        alloc_keys(mq, mq->key_range, range);
+        mq->key_range = range;
+    }
+    mq->links[key].val = val;
+    list_push(mq, bucket_for(mq, val), key);
+    mq->n_items++;
+    return 0;
+}
+
+// moves the min into bucket 0 (radix) or the cursor onto it (dial), and
+// returns the bucket it's in
+static int find_min(MinQueue *mq) {
+    if (mq->kind == MQUEUE_DIAL) {
+        while (mq->heads[mq->cursor] == -1) {
+            mq->cursor = (mq->cursor + 1) % mq->n_buckets;
+        }
+        return mq->cursor;
+    }
+
+    if (mq->heads[0] != -1) {
+        return 0;
+    }
+    int b = 1;
+    while (mq->heads[b] == -1) {
+        b++;
+    }
+    WEIGHT min = WEIGHT_MAX;
+    for (int k = mq->heads[b]; k != -1; k = mq->links[k].next) {
+        if (mq->links[k].val < min) {
+            min = mq->links[k].val;
+        }
+    }
+    mq->last = min;
+    int k = mq->heads[b];
+    mq->heads[b] = -1;
+    while (k != -1) {
+        int next = mq->links[k].next;
+        list_push(mq, radix_bucket(min, mq->links[k].val), k);
+        k = next;
+    }
+    return 0;
+}
+
+int bucket_peek(MinQueue *mq, int *key, WEIGHT *val) {
+    if (mq->n_items == 0) {
+        return 0;
+    }
+    int k = mq->heads[find_min(mq)];
+    if (mq->kind == MQUEUE_DIAL) {
+        // everything in the cursor's bucket has the same value
+        mq->last = mq->links[k].val;
+    }
+    *key = k;
+    *val = mq->links[k].val;
+    return 1;
+}
+
+int bucket_pop(MinQueue *mq, int *key, WEIGHT *val) {
+    int k;
+    WEIGHT v;
+    if (!bucket_peek(mq, &k, &v)) {
+        return 0;
+    }
+    list_remove(mq, k);
+    mq->n_items--;
+    if (key != NULL) {
+        *key = k;
+    }
+    if (val != NULL) {
+        *val = v;
+    }
+    return 1;
+}
+
+void bucket_update(MinQueue *mq, int key, WEIGHT new_val) {
+    list_remove(mq, key);
+    mq->links[key].val = new_val;
+    list_push(mq, bucket_for(mq, new_val), key);
+}
+
+void bucket_remove(MinQueue *mq, int key) {
+    list_remove(mq, key);
+    mq->n_items--;
+}
+
+void bucket_free(MinQueue *mq) {
+    free(mq->heads);
+    free(mq->links);
+}
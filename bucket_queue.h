@@ -0,0 +1,18 @@
+#ifndef __BUCKET_QUEUE_H__
+#define __BUCKET_QUEUE_H__
+
+#include "min_queue.h"
+
+// the radix and dial kinds of MinQueue. min_queue.c hands these the calls
+// for those kinds, so use the mqueue_* functions instead of calling them
+void bucket_init(MinQueue *mq, WEIGHT max_weight);
+void bucket_clear(MinQueue *mq);
+int bucket_push(MinQueue *mq, int key, WEIGHT val);
+int bucket_peek(MinQueue *mq, int *key, WEIGHT *val);
+int bucket_pop(MinQueue *mq, int *key, WEIGHT *val);
+void bucket_update(MinQueue *mq, int key, WEIGHT new_val);
+void bucket_remove(MinQueue *mq, int key);
+int bucket_contains(MinQueue *mq, int key);
+void bucket_free(MinQueue *mq);
+
+#endif
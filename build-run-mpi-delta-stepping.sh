@@ -0,0 +1,45 @@
+#!/bin/bash
+#SBATCH --partition=cpsc424_gpu
+# set total number of MPI processes
+#SBATCH --ntasks=2
+# set number of MPI processes per node
+# (number of nodes is calculated by Slurm)
+#SBATCH --ntasks-per-node=2
+# set number of cpus per MPI process. The hybrid runs below put 2 ranks of
+# 4 threads (or 1 of 8) on one node's 8 cores
+#SBATCH --cpus-per-task=4
+# set memory per cpu
+#SBATCH --mem-per-cpu=6100mb
+#SBATCH --job-name=MPI_RUN
+#SBATCH --time=15:00
+
+module load Langs/Intel/15 MPI/OpenMPI/2.1.1-intel15
+pwd
+# echo some environment variables
+echo $SLURM_JOB_NODELIST
+echo $SLURM_NTASKS_PER_NODE
+# Do a clean build
+make clean
+# My MPI program is task2
+make
+# The following mpirun command will pick up required info on nodes and cpus from Slurm.
+# You can use mpirun's -n option to reduce the number of MPI processes started on the cpus. (At most 1 MPI proc per Slurm task.)
+# You can use mpirun options to control the layout of MPI processes---e.g., to spread processes out onto multiple nodes
+# In this example, we've asked Slurm for 4 tasks (2 each on 2 nodes), but we've asked mpirun for two MPI procs, which will go onto 1 node.
+# (If "-n 2" is omitted, you'll get 4 MPI procs (1 per Slurm task)
+export nodes=8192
+export edges=741455
+# DELTA=<width> overrides the bucket width, the default is max_weight / average degree
+# one thread per rank, so the proc counts compare with the hybrid runs below
+export OMP_NUM_THREADS=1
+# mpirun counts Slurm's 2 slots, not the 8 cores under them, so the one
+# thread runs oversubscribe the slots and bind a rank to each core
+time mpirun --oversubscribe --bind-to core -n 1 ./mpi_delta_stepping $nodes $edges 10
+time mpirun --oversubscribe --bind-to core -n 2 ./mpi_delta_stepping $nodes $edges 10
+time mpirun --oversubscribe --bind-to core -n 4 ./mpi_delta_stepping $nodes $edges 10
+time mpirun --oversubscribe --bind-to core -n 8 ./mpi_delta_stepping $nodes $edges 10
+# hybrid: one rank per socket (or node) with OpenMP threads on its cores. MPI
+# is only called from the master thread, so funneled is enough
+export MPI_THREADS=funneled
+time mpirun -n 2 --map-by socket:PE=4 -x OMP_NUM_THREADS=4 -x MPI_THREADS ./mpi_delta_stepping $nodes $edges 10
+time mpirun -n 1 --map-by node:PE=8 -x OMP_NUM_THREADS=8 -x MPI_THREADS ./mpi_delta_stepping $nodes $edges 10
@@ -1,12 +1,13 @@
 #!/bin/bash
 #SBATCH --partition=cpsc424_gpu
 # set total number of MPI processes
-#SBATCH --ntasks=8
+#SBATCH --ntasks=2
 # set number of MPI processes per node
 # (number of nodes is calculated by Slurm)
-#SBATCH --ntasks-per-node=8
-# set number of cpus per MPI process
-#SBATCH --cpus-per-task=1
+#SBATCH --ntasks-per-node=2
+# set number of cpus per MPI process. The hybrid runs below put 2 ranks of
+# 4 threads (or 1 of 8) on one node's 8 cores
+#SBATCH --cpus-per-task=4
 # set memory per cpu
 #SBATCH --mem-per-cpu=6100mb
 #SBATCH --job-name=MPI_RUN
@@ -28,7 +29,16 @@ make
 # (If "-n 2" is omitted, you'll get 4 MPI procs (1 per Slurm task)
 export nodes=8192
 export edges=741455
-time mpirun -n 1 ./parallel_dijkstra $nodes $edges 10
-time mpirun -n 2 ./parallel_dijkstra $nodes $edges 10
-time mpirun -n 4 ./parallel_dijkstra $nodes $edges 10
-time mpirun -n 8 ./parallel_dijkstra $nodes $edges 10
+# one thread per rank, so the proc counts compare with the hybrid runs below
+export OMP_NUM_THREADS=1
+# mpirun counts Slurm's 2 slots, not the 8 cores under them, so the one
+# thread runs oversubscribe the slots and bind a rank to each core
+time mpirun --oversubscribe --bind-to core -n 1 ./parallel_dijkstra $nodes $edges 10
+time mpirun --oversubscribe --bind-to core -n 2 ./parallel_dijkstra $nodes $edges 10
+time mpirun --oversubscribe --bind-to core -n 4 ./parallel_dijkstra $nodes $edges 10
+time mpirun --oversubscribe --bind-to core -n 8 ./parallel_dijkstra $nodes $edges 10
+# hybrid: one rank per socket (or node) with OpenMP threads on its cores. MPI
+# is only called from the master thread, so funneled is enough
+export MPI_THREADS=funneled
+time mpirun -n 2 --map-by socket:PE=4 -x OMP_NUM_THREADS=4 -x MPI_THREADS ./parallel_dijkstra $nodes $edges 10
+time mpirun -n 1 --map-by node:PE=8 -x OMP_NUM_THREADS=8 -x MPI_THREADS ./parallel_dijkstra $nodes $edges 10
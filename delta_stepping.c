@@ -0,0 +1,254 @@
+// shared memory delta-stepping (Meyer & Sanders) with OpenMP.
+//
+// Vertices are kept in buckets of width delta by tentative distance. The
+// lowest non-empty bucket is settled in rounds: every round relaxes the light
+// (w <= delta) in edges of the bucket's vertices in parallel, which can only
+// refill the same bucket or later ones. Once the bucket stays empty, the heavy
+// edges of everything that went through it are relaxed once, since those can
+// only land in later buckets. Each thread collects new bucket entries in its
+// own bins and the next round's frontier is stitched together from them, so
+// the only shared writes during relaxation are the atomic-min distance updates.
+#include <stdio.h>
+#include <limits.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "helpers.h"
+#include "benchmarks.h"
+#include "resultr.h"
+#include "intvec.h"
+
+// a thread's bins, bins[b] holds the vertices it pushed into bucket b
+typedef struct {
+    IntVec *bins;
+    long n_bins;
+} LocalBins;
+
+int delta_stepping(Graph *graph, int n_nodes, int dest, WEIGHT delta, WEIGHT *distances, int *next_hops);
+
+int main(int argc, char **argv) {
+
+    double start_wall, end_wall, cpu;
+
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: delta_stepping [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
+        exit(1);
+    }
+
+    debug_init();
+
+    Graph *graph = load_graph(graph_file, n_nodes, n_edges, max_weight);
+    if (graph == NULL) {
+        exit(1);
+    }
+    // everything below reads the graph through edge iterators
+    graph = pack_graph_if_asked(graph);
+
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    WEIGHT delta = pick_delta(graph_max_weight(graph), n_nodes, graph->n_edges);
+    printf("Delta stepping with %d threads, delta %" WEIGHT_FMT "\n", n_threads, delta);
+
+    WEIGHT *distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *next_hops = calloc(n_nodes, sizeof(int));
+
+    timing(&start_wall, &cpu);
+    delta_stepping(graph, n_nodes, 0, delta, distances, next_hops);
+    timing(&end_wall, &cpu);
+    printf("Delta stepping's time: %.4f\n", end_wall - start_wall);
+
+    store_result_soft(SEED, n_nodes, n_edges, max_weight, ALGO_DELTA_STEPPING, distances, next_hops);
+
+    // for comparison, get results from serial dijsktra
+    WEIGHT *ser_distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *ser_next_hops = calloc(n_nodes, sizeof(int));
+    if (read_result(SEED, n_nodes, n_edges, max_weight, ALGO_SER_DIJKSTRA, ser_distances, ser_next_hops) == -1) {
+        printf("Could not read past result!\n");
+    } else {
+        printf("L2 norm with serial dijkstra: %lf\n", l2_norm(distances, ser_distances, n_nodes));
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    ///  CLEAN UP
+    ///////////////////////////////////////////////////////////////////////////
+    free(ser_distances);
+    free(ser_next_hops);
+    free(distances);
+    free(next_hops);
+    graph_free(graph);
+
+    return 0;
+}
+
+static void bins_push(LocalBins *lb, long b, int v) {
+    if (b >= lb->n_bins) {
+        long n_bins = lb->n_bins ? lb->n_bins : 16;
+        while (n_bins <= b) {
+            n_bins *= 2;
+        }
+        lb->bins = realloc(lb->bins, n_bins * sizeof(IntVec));
+        memset(lb->bins + lb->n_bins, 0, (n_bins - lb->n_bins) * sizeof(IntVec));
+        lb->n_bins = n_bins;
+    }
+    vec_push(&lb->bins[b], v);
+}
+
+// relaxes the light (heavy == 0) or heavy (heavy == 1) in edges of u, which
+// is at distance d. Goes through the edge iterator and splits the edges as
+// it goes, so the graph can stay packed
+static void relax(Graph *graph, int u, int heavy, WEIGHT d, WEIGHT delta, WEIGHT *distances, LocalBins *lb) {
+    EdgeIter it;
+    graph_in_iter(graph, u, &it);
+    int n;
+    WEIGHT w;
+    while (edge_iter_next(&it, &n, &w)) {
+        if ((w > delta) != heavy) {
+            continue;
+        }
+        WEIGHT alt_dist = weight_add(d, w);
+        // a saturated distance is as good as unreachable, don't give it a bucket
+        if (alt_dist != WEIGHT_MAX && atomic_min_weight(&distances[n], alt_dist)) {
+            bins_push(lb, alt_dist / delta, n);
+        }
+    }
+}
+
+int delta_stepping(Graph *graph, int n_nodes, int dest, WEIGHT delta, WEIGHT *distances, int *next_hops) {
+    graph_build_reverse(graph);
+
+    // heavy_bucket[v] is the last bucket whose heavy edges v has queued
+    // for, so a vertex that goes through a bucket twice only does them once
+    long *heavy_bucket = malloc((n_nodes ? n_nodes : 1) * sizeof(long));
+    #pragma omp parallel for
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = WEIGHT_MAX;
+        heavy_bucket[v] = -1;
+    }
+    distances[dest] = 0;
+
+    // shared round state, only changed inside single blocks
+    long frontier_capacity = 1024;
+    int *frontier = malloc(frontier_capacity * sizeof(int));
+    frontier[0] = dest;
+    long frontier_len = 1;
+    long bucket = 0;
+    long next_bucket = LONG_MAX;
+    long next_len = 0;
+    int refilled = 0;
+    long rounds = 0;
+
+    #pragma omp parallel
+    {
+        LocalBins lb = {NULL, 0};
+        IntVec settled = {NULL, 0, 0};
+
+        while (1) {
+            // light edges of this round's frontier
+            #pragma omp for schedule(dynamic, 64)
+            for (long i = 0; i < frontier_len; i++) {
+                int u = frontier[i];
+                WEIGHT d = __atomic_load_n(&distances[u], __ATOMIC_RELAXED);
+                // stale if u dropped into an earlier bucket after this entry
+                // was queued, it was settled there
+                if (d / delta != bucket) {
+                    continue;
+                }
+                // u can be in the frontier more than once, and those copies
+                // can be on different threads, so exactly one of them claims it
+                if (__atomic_exchange_n(&heavy_bucket[u], bucket, __ATOMIC_RELAXED) != bucket) {
+                    vec_push(&settled, u);
+                }
+                relax(graph, u, 0, d, delta, distances, &lb);
+            }
+
+            if (bucket < lb.n_bins && lb.bins[bucket].len > 0) {
+                #pragma omp atomic write
+                refilled = 1;
+            }
+            #pragma omp barrier
+
+            if (!refilled) {
+                // the bucket is done, so its vertices are final: heavy edges now
+                for (long i = 0; i < settled.len; i++) {
+                    int u = settled.items[i];
+                    relax(graph, u, 1, __atomic_load_n(&distances[u], __ATOMIC_RELAXED), delta, distances, &lb);
+                }
+                settled.len = 0;
+                #pragma omp barrier
+
+                long mine = LONG_MAX;
+                for (long b = bucket + 1; b < lb.n_bins; b++) {
+                    if (lb.bins[b].len > 0) {
+                        mine = b;
+                        break;
+                    }
+                }
+                #pragma omp critical
+                if (mine < next_bucket) {
+                    next_bucket = mine;
+                }
+            } else {
+                #pragma omp single
+                next_bucket = bucket;
+            }
+            #pragma omp barrier
+
+            if (next_bucket == LONG_MAX) {
+                break;
+            }
+
+            // stitch the next frontier together from everyone's bins
+            long my_len = next_bucket < lb.n_bins ? lb.bins[next_bucket].len : 0;
+            long my_start;
+            #pragma omp atomic capture
+            {
+                my_start = next_len;
+                next_len += my_len;
+            }
+            #pragma omp barrier
+            #pragma omp single
+            if (next_len > frontier_capacity) {
+                while (frontier_capacity < next_len) {
+                    frontier_capacity *= 2;
+                }
+                free(frontier);
+                frontier = malloc(frontier_capacity * sizeof(int));
+            }
+            if (my_len > 0) {
+                memcpy(frontier + my_start, lb.bins[next_bucket].items, my_len * sizeof(int));
+                lb.bins[next_bucket].len = 0;
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                frontier_len = next_len;
+                bucket = next_bucket;
+                next_len = 0;
+                next_bucket = LONG_MAX;
+                refilled = 0;
+                rounds++;
+            }
+        }
+
+        for (long b = 0; b < lb.n_bins; b++) {
+            free(lb.bins[b].items);
+        }
+        free(lb.bins);
+        free(settled.items);
+    }
+    debugf("delta stepping took %ld rounds\n", rounds);
+
+    recompute_next_hops(graph, n_nodes, dest, distances, next_hops);
+
+    free(frontier);
+    free(heavy_bucket);
+    return 0;
+}
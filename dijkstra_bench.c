@@ -0,0 +1,98 @@
+// times decrease-key Dijkstra against serial_dijkstra_lazy on graphs of the
+// same size going from sparse to dense. Decrease-key runs twice: with every
+// vertex in the heap from the start (the old serial_dijkstra), and pushing
+// vertices as they're reached like serial_dijkstra does now
+#include "benchmarks.h"
+
+// the densest graph we'll build, ~1 GB with its reverse index
+#define MAX_BENCH_EDGES (1UL << 25)
+
+typedef int (*ENGINE)(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *next_hops);
+
+// decrease-key with a full sized heap: every vertex goes in at WEIGHT_MAX
+// before the first pop
+static int dijkstra_upfront(Graph *graph, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    graph_build_reverse(graph);
+    MinQueue *mq = mqueue_init(n_nodes);
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = v == dest ? 0 : WEIGHT_MAX;
+        next_hops[v] = -1;
+        mqueue_push(mq, v, distances[v]);
+    }
+
+    int v;
+    while (mqueue_pop(mq, &v, NULL)) {
+        EdgeIter it;
+        graph_in_iter(graph, v, &it);
+        int n;
+        WEIGHT w;
+        while (edge_iter_next(&it, &n, &w)) {
+            WEIGHT alt_dist = weight_add(distances[v], w);
+            if (alt_dist < distances[n]) {
+                distances[n] = alt_dist;
+                next_hops[n] = v;
+                mqueue_update_key(mq, n, alt_dist);
+            }
+        }
+    }
+
+    mqueue_free(mq);
+    return 0;
+}
+
+static double time_engine(ENGINE engine, Graph *graph, int n_nodes, unsigned long n_edges, WEIGHT *distances, int *next_hops) {
+    double start_wall, end_wall, cpu;
+    timing(&start_wall, &cpu);
+    engine(graph, n_nodes, n_edges, 0, distances, next_hops);
+    timing(&end_wall, &cpu);
+    return end_wall - start_wall;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        printf("Usage: dijkstra_bench [n_nodes] [max_weight]\n");
+        exit(1);
+    }
+    int n_nodes = atoi(argv[1]);
+    int max_weight = atoi(argv[2]);
+    if (n_nodes < 2 || max_weight < 1) {
+        printf("Usage: dijkstra_bench [n_nodes] [max_weight]\n");
+        exit(1);
+    }
+
+    debug_init();
+
+    WEIGHT *upfront_distances = calloc(n_nodes, sizeof(WEIGHT));
+    WEIGHT *distances = calloc(n_nodes, sizeof(WEIGHT));
+    WEIGHT *lazy_distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *next_hops = calloc(n_nodes, sizeof(int));
+
+    // average out degrees, up to a quarter of the vertices (or MAX_BENCH_EDGES)
+    int degrees[] = {1, 2, 4, 16, 64, 256, 1024, 4096};
+    // speedup is upfront over lazy, the comparison the lazy engine was made for
+    printf("%10s %14s %12s %12s %12s %8s\n", "degree", "edges", "upfront", "on-reach", "lazy", "speedup");
+    for (int d = 0; d < (int) (sizeof(degrees) / sizeof(degrees[0])); d++) {
+        unsigned long n_edges = (unsigned long) degrees[d] * n_nodes;
+        if (d > 0 && (degrees[d] > (n_nodes - 1) / 4 || n_edges > MAX_BENCH_EDGES)) {
+            break;
+        }
+        // generated, not cached, so the sweep doesn't fill up graphs/
+        Graph *graph = gen_graph_rows(n_nodes, n_edges, max_weight, 0, n_nodes);
+        graph_build_reverse(graph);
+
+        double t_up = time_engine(dijkstra_upfront, graph, n_nodes, graph->n_edges, upfront_distances, next_hops);
+        double t_dk = time_engine(serial_dijkstra, graph, n_nodes, graph->n_edges, distances, next_hops);
+        double t_lazy = time_engine(serial_dijkstra_lazy, graph, n_nodes, graph->n_edges, lazy_distances, next_hops);
+        printf("%10d %14lu %12.4f %12.4f %12.4f %7.2fx%s\n", degrees[d], graph->n_edges, t_up, t_dk, t_lazy, t_up / t_lazy,
+                memcmp(distances, lazy_distances, n_nodes * sizeof(WEIGHT))
+                        || memcmp(upfront_distances, lazy_distances, n_nodes * sizeof(WEIGHT)) ? "  DISAGREE" : "");
+        fflush(stdout);
+        graph_free(graph);
+    }
+
+    free(upfront_distances);
+    free(distances);
+    free(lazy_distances);
+    free(next_hops);
+    return 0;
+}
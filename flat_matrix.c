@@ -4,24 +4,25 @@ FlatMatrix *flat_matrix_init(int width, int height) {
     FlatMatrix *fm = malloc(sizeof(FlatMatrix));
     fm->width = width;
     fm->height = height;
-    fm->arr = calloc(width * height, sizeof(WEIGHT));
+    fm->arr = calloc((unsigned long) width * height, sizeof(WEIGHT));
     return fm;
 }
 
 int flat_matrix_set(FlatMatrix *fm, int r, int c, WEIGHT val) {
-    if (c >= fm->height || c >= fm->width) {
+    if (r >= fm->height || c >= fm->width) {
         return -1;
     }
     // the index might be bigger than an int
-    unsigned long idx = r * fm->width + c;
+    unsigned long idx = (unsigned long) r * fm->width + c;
     fm->arr[idx] = val;
+    return 0;
 }
 
 WEIGHT flat_matrix_get(FlatMatrix *fm, int r, int c) {
     if (r >= fm->height || c >= fm->width) {
         return -1;
     }
-    unsigned long idx = r * fm->width + c;
+    unsigned long idx = (unsigned long) r * fm->width + c;
     return fm->arr[idx];
 }
 
@@ -30,7 +31,7 @@ FlatMatrix *flat_matrix_from_2d_arr(WEIGHT **arr, int width, int height) {
     FlatMatrix *fm = malloc(sizeof(FlatMatrix));
     fm->width = width;
     fm->height = height;
-    fm->arr = malloc(width * height * sizeof(WEIGHT));
+    fm->arr = malloc((unsigned long) width * height * sizeof(WEIGHT));
     // now we fill in the matrix
     for (int r = 0; r < height; r++) {
         for (int c = 0; c < width; c++) {
@@ -48,7 +49,7 @@ void flat_matrix_free(FlatMatrix *fm) {
 void flat_matrix_print(FlatMatrix *fm) {
     for (int r = 0; r < fm->height; r++) {
         for (int c = 0; c < fm->width; c++) {
-            printf("%3d ", flat_matrix_get(fm, r, c));
+            printf("%3" WEIGHT_FMT " ", flat_matrix_get(fm, r, c));
         }
         printf("\n");
     }
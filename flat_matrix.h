@@ -3,7 +3,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#define WEIGHT int
+
+#include "types.h"
 
 typedef struct {
     WEIGHT *arr;
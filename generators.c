@@ -0,0 +1,473 @@
+// random graph generators. The edge count of every row is decided by a
+// binary "split tree" over the rows: a tree node holding c edges hands a
+// binomial share of them to its left half and the rest to its right half,
+// with the node's random draw keyed by its position. Any range of rows can
+// then be generated by walking down to just that range, without generating
+// (or storing) anything for the other rows.
+#include "helpers.h"
+#include "generators.h"
+#include "rng.h"
+
+#define PI 3.14159265358979323846
+
+// R-MAT quadrant probabilities (Graph500 values)
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+#define RMAT_D 0.05
+
+// how far (in lattice steps) a grid shortcut can reach
+#define GRID_SHORTCUT_RADIUS 4
+
+// streams, offset by the model so no two models share random numbers
+enum RNG_STREAM {
+    STREAM_SPLIT = 1,
+    STREAM_TARGET,
+    STREAM_WEIGHT,
+    STREAM_POINT,
+};
+
+static const char *MODEL_NAMES[] = {"uniform", "rmat", "grid", "geometric"};
+
+typedef struct {
+    GRAPH_MODEL model;
+    int n_nodes;
+    int max_weight;
+    int scale; // the split tree covers rows [0, 1 << scale)
+
+    // grid: lattice width
+    int grid_width;
+
+    // geometric: the points, bucketed into cells at least radius wide
+    double radius;
+    int n_cells;
+    float *xs;
+    float *ys;
+    int *cell_start;
+    int *cell_nodes;
+} GenCtx;
+
+// open addressing set of target ids, for rejecting duplicate edges in a row
+typedef struct {
+    int *keys;
+    unsigned long mask;
+    unsigned long capacity;
+} RowSet;
+
+GRAPH_MODEL graph_model_from_env() {
+    char *name = getenv("GRAPH_MODEL");
+    if (name == NULL) {
+        return MODEL_UNIFORM;
+    }
+    for (int m = 0; m < (int) (sizeof(MODEL_NAMES) / sizeof(MODEL_NAMES[0])); m++) {
+        if (strcmp(name, MODEL_NAMES[m]) == 0) {
+            return m;
+        }
+    }
+    printf("WARNING: unknown GRAPH_MODEL %s, using uniform\n", name);
+    return MODEL_UNIFORM;
+}
+
+const char *graph_model_name(GRAPH_MODEL model) {
+    return MODEL_NAMES[model];
+}
+
+static unsigned long long draw(GenCtx *ctx, int stream, unsigned long long counter) {
+    return rng_at(SEED, ctx->model * 16 + stream, counter);
+}
+
+static WEIGHT edge_weight(GenCtx *ctx, int u, int v) {
+    unsigned long long key = ((unsigned long long) u << 32) | (unsigned int) v;
+    return rng_below(draw(ctx, STREAM_WEIGHT, key), ctx->max_weight) + 1;
+}
+
+// binomial(n, p) from a single key. Inverts the pmf when the mean is small
+// and falls back to a normal approximation when it isn't
+static unsigned long binomial(unsigned long n, double p, unsigned long long key) {
+    if (p <= 0 || n == 0) {
+        return 0;
+    }
+    if (p >= 1) {
+        return n;
+    }
+    if (p > 0.5) {
+        return n - binomial(n, 1 - p, key);
+    }
+    double mean = n * p;
+    if (mean < 30) {
+        double u = rng_unit(mix64(key));
+        double q = 1 - p;
+        double pmf = pow(q, (double) n);
+        double cdf = pmf;
+        unsigned long k = 0;
+        while (u > cdf && k < n) {
+            pmf *= (double) (n - k) / (k + 1) * p / q;
+            k++;
+            cdf += pmf;
+            // rounding can leave cdf a hair under u forever
+            if (k > mean && pmf < 1e-17) {
+                break;
+            }
+        }
+        return k;
+    }
+    double u1 = rng_unit(mix64(key));
+    double u2 = rng_unit(mix64(key + 1));
+    if (u1 < 1e-300) {
+        u1 = 1e-300;
+    }
+    double z = sqrt(-2 * log(u1)) * cos(2 * PI * u2);
+    double x = floor(mean + z * sqrt(mean * (1 - p)) + 0.5);
+    if (x < 0) {
+        return 0;
+    }
+    if (x > n) {
+        return n;
+    }
+    return (unsigned long) x;
+}
+
+// rows of [lo, lo + 2^k) that actually exist
+static unsigned long block_rows(GenCtx *ctx, unsigned long lo, int k) {
+    unsigned long hi = lo + (1UL << k);
+    if (lo >= (unsigned long) ctx->n_nodes) {
+        return 0;
+    }
+    return (hi > (unsigned long) ctx->n_nodes ? (unsigned long) ctx->n_nodes : hi) - lo;
+}
+
+// how much of the edge mass falls in [lo, lo + 2^k). prefix is the weight
+// the fixed high bits of the block already carry (only R-MAT cares)
+static double block_weight(GenCtx *ctx, unsigned long lo, int k, double prefix) {
+    if (ctx->model != MODEL_RMAT) {
+        return block_rows(ctx, lo, k);
+    }
+    unsigned long rows = block_rows(ctx, lo, k);
+    if (rows == 0) {
+        return 0;
+    }
+    if (rows == (1UL << k)) {
+        return prefix;
+    }
+    // block straddles n_nodes, so add up the halves
+    return block_weight(ctx, lo, k - 1, prefix * (RMAT_A + RMAT_B))
+        + block_weight(ctx, lo + (1UL << (k - 1)), k - 1, prefix * (RMAT_C + RMAT_D));
+}
+
+// the block [lo, lo + 2^k) holds count edges; write the row degrees that fall
+// in [want_lo, want_hi) into degrees (indexed from want_lo)
+static void split_rows(GenCtx *ctx, unsigned long lo, int k, double prefix, unsigned long count,
+        int want_lo, int want_hi, unsigned long *degrees) {
+    unsigned long size = 1UL << k;
+    if (count == 0 || lo >= (unsigned long) want_hi || lo + size <= (unsigned long) want_lo) {
+        return;
+    }
+    if (k == 0) {
+        degrees[lo - want_lo] = count;
+        return;
+    }
+    unsigned long half = size / 2;
+    double left_prefix = prefix * (ctx->model == MODEL_RMAT ? RMAT_A + RMAT_B : 1);
+    double right_prefix = prefix * (ctx->model == MODEL_RMAT ? RMAT_C + RMAT_D : 1);
+    double wl = block_weight(ctx, lo, k - 1, left_prefix);
+    double wr = block_weight(ctx, lo + half, k - 1, right_prefix);
+
+    unsigned long left = 0;
+    if (wl + wr > 0) {
+        left = binomial(count, wl / (wl + wr), draw(ctx, STREAM_SPLIT, ((unsigned long long) lo << 6) | k));
+    }
+    // no row can take more than n_nodes - 1 edges
+    unsigned long cap_left = block_rows(ctx, lo, k - 1) * (ctx->n_nodes - 1);
+    unsigned long cap_right = block_rows(ctx, lo + half, k - 1) * (ctx->n_nodes - 1);
+    if (count - left > cap_right) {
+        left = count - cap_right;
+    }
+    if (left > cap_left) {
+        left = cap_left;
+    }
+
+    split_rows(ctx, lo, k - 1, left_prefix, left, want_lo, want_hi, degrees);
+    split_rows(ctx, lo + half, k - 1, right_prefix, count - left, want_lo, want_hi, degrees);
+}
+
+static void rowset_reset(RowSet *rs, unsigned long want) {
+    unsigned long cap = 16;
+    while (cap < 2 * want) {
+        cap *= 2;
+    }
+    if (cap > rs->capacity) {
+        free(rs->keys);
+        rs->keys = malloc(cap * sizeof(int));
+        rs->capacity = cap;
+    }
+    // only use as much of the table as this row needs, clearing all of it
+    // for every row after one hub row would be quadratic
+    rs->mask = cap - 1;
+    for (unsigned long i = 0; i <= rs->mask; i++) {
+        rs->keys[i] = -1;
+    }
+}
+
+// returns 1 if key was not in the set yet
+static int rowset_insert(RowSet *rs, int key) {
+    unsigned long i = mix64(key) & rs->mask;
+    while (rs->keys[i] != -1) {
+        if (rs->keys[i] == key) {
+            return 0;
+        }
+        i = (i + 1) & rs->mask;
+    }
+    rs->keys[i] = key;
+    return 1;
+}
+
+static int rowset_contains(RowSet *rs, int key) {
+    unsigned long i = mix64(key) & rs->mask;
+    while (rs->keys[i] != -1) {
+        if (rs->keys[i] == key) {
+            return 1;
+        }
+        i = (i + 1) & rs->mask;
+    }
+    return 0;
+}
+
+static void uniform_row(GenCtx *ctx, int u, unsigned long degree, RowSet *rs, EdgeList *el) {
+    unsigned long others = ctx->n_nodes - 1;
+    unsigned long long base = (unsigned long long) u << 32;
+    // for a nearly full row, pick the few targets to leave out instead
+    int complement = degree > others / 2;
+    unsigned long want = complement ? others - degree : degree;
+    rowset_reset(rs, want);
+    unsigned long got = 0;
+    for (unsigned long long j = 0; got < want; j++) {
+        int v = rng_below(draw(ctx, STREAM_TARGET, base + j), others);
+        if (v >= u) {
+            v++;
+        }
+        if (rowset_insert(rs, v)) {
+            got++;
+            if (!complement) {
+                edge_list_push(el, u, v, edge_weight(ctx, u, v));
+            }
+        }
+    }
+    if (complement) {
+        for (int v = 0; v < ctx->n_nodes; v++) {
+            if (v != u && !rowset_contains(rs, v)) {
+                edge_list_push(el, u, v, edge_weight(ctx, u, v));
+            }
+        }
+    }
+}
+
+static void rmat_row(GenCtx *ctx, int u, unsigned long degree, RowSet *rs, EdgeList *el) {
+    unsigned long long base = (unsigned long long) u << 32;
+    rowset_reset(rs, degree);
+    unsigned long got = 0;
+    // dense rows of a skewed graph can run out of distinct targets, so give up eventually
+    unsigned long max_tries = 16 * degree + 256;
+    for (unsigned long long j = 0; got < degree && j < max_tries; j++) {
+        unsigned long long key = draw(ctx, STREAM_TARGET, base + j);
+        int v = 0;
+        // walk down the quadrants, the row bits are already fixed by u
+        for (int level = ctx->scale - 1; level >= 0; level--) {
+            int row_bit = (u >> level) & 1;
+            double p_zero = row_bit ? RMAT_C / (RMAT_C + RMAT_D) : RMAT_A / (RMAT_A + RMAT_B);
+            if (rng_unit(mix64(key + level)) >= p_zero) {
+                v |= 1 << level;
+            }
+        }
+        if (v == u || v >= ctx->n_nodes) {
+            continue;
+        }
+        if (rowset_insert(rs, v)) {
+            got++;
+            edge_list_push(el, u, v, edge_weight(ctx, u, v));
+        }
+    }
+}
+
+static unsigned long grid_lattice_edges(int n_nodes, int width) {
+    unsigned long full_rows = n_nodes / width;
+    unsigned long last = n_nodes % width;
+    unsigned long horizontal = full_rows * (width - 1) + (last ? last - 1 : 0);
+    unsigned long vertical = (full_rows ? (full_rows - 1) * width + last : 0);
+    // every lattice edge goes both ways
+    return 2 * (horizontal + vertical);
+}
+
+static void grid_row(GenCtx *ctx, int u, unsigned long shortcuts, RowSet *rs, EdgeList *el) {
+    int width = ctx->grid_width;
+    int r = u / width;
+    int c = u % width;
+    int neighbors[4] = {
+        r > 0 ? u - width : -1,
+        u + width < ctx->n_nodes ? u + width : -1,
+        c > 0 ? u - 1 : -1,
+        c < width - 1 && u + 1 < ctx->n_nodes ? u + 1 : -1,
+    };
+    rowset_reset(rs, shortcuts + 4);
+    for (int i = 0; i < 4; i++) {
+        if (neighbors[i] != -1) {
+            rowset_insert(rs, neighbors[i]);
+            edge_list_push(el, u, neighbors[i], edge_weight(ctx, u, neighbors[i]));
+        }
+    }
+
+    int span = 2 * GRID_SHORTCUT_RADIUS + 1;
+    unsigned long long base = (unsigned long long) u << 32;
+    unsigned long got = 0;
+    unsigned long max_tries = 16 * shortcuts + 64;
+    for (unsigned long long j = 0; got < shortcuts && j < max_tries; j++) {
+        unsigned long long key = draw(ctx, STREAM_TARGET, base + j);
+        int dr = (int) rng_below(key, span) - GRID_SHORTCUT_RADIUS;
+        int dc = (int) rng_below(mix64(key), span) - GRID_SHORTCUT_RADIUS;
+        if (r + dr < 0 || c + dc < 0 || c + dc >= width) {
+            continue;
+        }
+        int v = (r + dr) * width + c + dc;
+        if (v == u || v >= ctx->n_nodes) {
+            continue;
+        }
+        if (rowset_insert(rs, v)) {
+            got++;
+            edge_list_push(el, u, v, edge_weight(ctx, u, v));
+        }
+    }
+}
+
+static void geometric_init(GenCtx *ctx, unsigned long n_edges) {
+    int n = ctx->n_nodes;
+    // two uniform points in the unit square are within r of each other with
+    // probability pi r^2 - 8/3 r^3 + 1/2 r^4 (for r <= 1), so bisect for the r
+    // that gives n_edges ordered pairs
+    double want = n > 1 ? n_edges / (n * (double) (n - 1)) : 0;
+    double lo = 0;
+    double hi = 1;
+    for (int i = 0; i < 60; i++) {
+        double r = (lo + hi) / 2;
+        double p = PI * r * r - 8.0 / 3 * r * r * r + 0.5 * r * r * r * r;
+        if (p < want) {
+            lo = r;
+        } else {
+            hi = r;
+        }
+    }
+    ctx->radius = hi;
+    int cells = (int) (1 / ctx->radius);
+    int max_cells = (int) sqrt((double) n) + 1;
+    if (cells > max_cells) {
+        cells = max_cells;
+    }
+    if (cells < 1) {
+        cells = 1;
+    }
+    ctx->n_cells = cells;
+
+    ctx->xs = malloc(n * sizeof(float));
+    ctx->ys = malloc(n * sizeof(float));
+    ctx->cell_start = calloc(cells * cells + 1, sizeof(int));
+    ctx->cell_nodes = malloc(n * sizeof(int));
+    int *cell_of = malloc(n * sizeof(int));
+    for (int u = 0; u < n; u++) {
+        ctx->xs[u] = rng_unit(draw(ctx, STREAM_POINT, 2 * (unsigned long long) u));
+        ctx->ys[u] = rng_unit(draw(ctx, STREAM_POINT, 2 * (unsigned long long) u + 1));
+        int cx = (int) (ctx->xs[u] * cells);
+        int cy = (int) (ctx->ys[u] * cells);
+        cell_of[u] = cy * cells + cx;
+        ctx->cell_start[cell_of[u] + 1]++;
+    }
+    for (int i = 0; i < cells * cells; i++) {
+        ctx->cell_start[i + 1] += ctx->cell_start[i];
+    }
+    int *cursor = malloc(cells * cells * sizeof(int));
+    memcpy(cursor, ctx->cell_start, cells * cells * sizeof(int));
+    for (int u = 0; u < n; u++) {
+        ctx->cell_nodes[cursor[cell_of[u]]++] = u;
+    }
+    free(cursor);
+    free(cell_of);
+}
+
+static void geometric_row(GenCtx *ctx, int u, EdgeList *el) {
+    int cells = ctx->n_cells;
+    int cx = (int) (ctx->xs[u] * cells);
+    int cy = (int) (ctx->ys[u] * cells);
+    double r2 = ctx->radius * ctx->radius;
+    for (int y = cy - 1; y <= cy + 1; y++) {
+        for (int x = cx - 1; x <= cx + 1; x++) {
+            if (x < 0 || y < 0 || x >= cells || y >= cells) {
+                continue;
+            }
+            int cell = y * cells + x;
+            for (int i = ctx->cell_start[cell]; i < ctx->cell_start[cell + 1]; i++) {
+                int v = ctx->cell_nodes[i];
+                double dx = ctx->xs[u] - ctx->xs[v];
+                double dy = ctx->ys[u] - ctx->ys[v];
+                double d2 = dx * dx + dy * dy;
+                if (v == u || d2 >= r2) {
+                    continue;
+                }
+                // longer edges cost more
+                WEIGHT w = (WEIGHT) ceil(sqrt(d2) / ctx->radius * ctx->max_weight);
+                edge_list_push(el, u, v, w < 1 ? 1 : w);
+            }
+        }
+    }
+}
+
+EdgeList *gen_edges(GRAPH_MODEL model, int n_nodes, unsigned long n_edges, int max_weight, int row_lo, int row_hi) {
+    GenCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.model = model;
+    ctx.n_nodes = n_nodes;
+    ctx.max_weight = max_weight;
+    while ((1L << ctx.scale) < n_nodes) {
+        ctx.scale++;
+    }
+
+    int n_rows = row_hi - row_lo;
+    unsigned long *degrees = calloc(n_rows ? n_rows : 1, sizeof(unsigned long));
+    // what the split tree hands out: every edge, or for the grid just the shortcuts
+    unsigned long to_split = n_edges;
+    if (model == MODEL_GRID) {
+        ctx.grid_width = (int) ceil(sqrt((double) n_nodes));
+        unsigned long lattice = grid_lattice_edges(n_nodes, ctx.grid_width);
+        to_split = n_edges > lattice ? n_edges - lattice : 0;
+    }
+    if (model == MODEL_GEOMETRIC) {
+        geometric_init(&ctx, n_edges);
+    } else {
+        split_rows(&ctx, 0, ctx.scale, 1.0, to_split, row_lo, row_hi, degrees);
+    }
+
+    EdgeList *el = edge_list_init(n_edges / (n_nodes ? n_nodes : 1) * n_rows + 16);
+    RowSet rs = {NULL, 0, 0};
+    rowset_reset(&rs, 16);
+    for (int u = row_lo; u < row_hi; u++) {
+        unsigned long degree = degrees[u - row_lo];
+        switch (model) {
+            case MODEL_UNIFORM:
+                uniform_row(&ctx, u, degree, &rs, el);
+                break;
+            case MODEL_RMAT:
+                rmat_row(&ctx, u, degree, &rs, el);
+                break;
+            case MODEL_GRID:
+                grid_row(&ctx, u, degree, &rs, el);
+                break;
+            case MODEL_GEOMETRIC:
+                geometric_row(&ctx, u, el);
+                break;
+        }
+    }
+
+    free(rs.keys);
+    free(degrees);
+    free(ctx.xs);
+    free(ctx.ys);
+    free(ctx.cell_start);
+    free(ctx.cell_nodes);
+    return el;
+}
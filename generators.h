@@ -0,0 +1,30 @@
+#ifndef __GENERATORS_H__
+#define __GENERATORS_H__
+
+#include "graph.h"
+
+// random graph models. All of them are O(E) and never touch an n x n matrix
+typedef enum {
+    MODEL_UNIFORM,      // G(n, m): m distinct edges picked uniformly
+    MODEL_RMAT,         // R-MAT / Kronecker, skewed power law degrees
+    MODEL_GRID,         // 2D lattice (both directions) plus short local shortcuts, road-like
+    MODEL_GEOMETRIC,    // random points in the unit square, edges between close points
+} GRAPH_MODEL;
+
+// picks the model from the GRAPH_MODEL environment variable
+// (uniform, rmat, grid or geometric). Defaults to uniform
+GRAPH_MODEL graph_model_from_env();
+const char *graph_model_name(GRAPH_MODEL model);
+
+// generates the out edges of rows [row_lo, row_hi) of a model graph, with
+// weights in 1..max_weight. Every random draw comes from a counter based
+// stream keyed by SEED and the row, so a row always gets the same edges no
+// matter which range it is generated in.
+//
+// n_edges is exact for uniform. R-MAT can come up slightly short on rows
+// whose targets keep colliding, grid always has its lattice edges and only
+// adds shortcuts up to n_edges, and geometric picks its radius so that the
+// expected edge count is n_edges.
+EdgeList *gen_edges(GRAPH_MODEL model, int n_nodes, unsigned long n_edges, int max_weight, int row_lo, int row_hi);
+
+#endif
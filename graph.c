@@ -0,0 +1,305 @@
+#include <sys/mman.h>
+
+#include "graph.h"
+
+EdgeList *edge_list_init(unsigned long capacity) {
+    EdgeList *el = malloc(sizeof(EdgeList));
+    el->capacity = capacity ? capacity : 16;
+    el->n_edges = 0;
+    el->edges = malloc(el->capacity * sizeof(Edge));
+    return el;
+}
+
+void edge_list_push(EdgeList *el, int n1, int n2, WEIGHT weight) {
+    if (el->n_edges == el->capacity) {
+        el->capacity *= 2;
+        el->edges = realloc(el->edges, el->capacity * sizeof(Edge));
+    }
+    Edge e = {n1, n2, weight};
+    el->edges[el->n_edges++] = e;
+}
+
+void edge_list_free(EdgeList *el) {
+    free(el->edges);
+    free(el);
+}
+
+Graph *graph_init(int n_rows, int n_cols, unsigned long n_edges) {
+    Graph *g = malloc(sizeof(Graph));
+    g->n_rows = n_rows;
+    g->n_cols = n_cols;
+    g->n_edges = n_edges;
+    g->offsets = calloc(n_rows + 1, sizeof(unsigned long));
+    // malloc(0) is allowed to return NULL, so always ask for at least one slot
+    g->targets = malloc((n_edges ? n_edges : 1) * sizeof(int));
+    g->weights = malloc((n_edges ? n_edges : 1) * sizeof(WEIGHT));
+    g->rev_offsets = NULL;
+    g->rev_sources = NULL;
+    g->rev_weights = NULL;
+    g->packed = NULL;
+    g->rev_packed = NULL;
+    g->weight_bytes = sizeof(WEIGHT);
+    g->mapping = NULL;
+    g->mapping_len = 0;
+    return g;
+}
+
+// two stable counting sorts (by target, then by source) so that every row
+// comes out sorted by target without a comparison sort
+Graph *graph_from_edges(int n_rows, int n_cols, Edge *edges, unsigned long n_edges) {
+    Graph *g = graph_init(n_rows, n_cols, n_edges);
+
+    unsigned long *col_start = calloc(n_cols + 1, sizeof(unsigned long));
+    unsigned long *by_col = malloc((n_edges ? n_edges : 1) * sizeof(unsigned long));
+
+    for (unsigned long e = 0; e < n_edges; e++) {
+        col_start[edges[e].n2 + 1]++;
+        g->offsets[edges[e].n1 + 1]++;
+    }
+    for (int c = 0; c < n_cols; c++) {
+        col_start[c + 1] += col_start[c];
+    }
+    for (int r = 0; r < n_rows; r++) {
+        g->offsets[r + 1] += g->offsets[r];
+    }
+
+    for (unsigned long e = 0; e < n_edges; e++) {
+        by_col[col_start[edges[e].n2]++] = e;
+    }
+
+    // col_start is spent, reuse the row offsets as insertion cursors instead
+    unsigned long *cursor = malloc((n_rows + 1) * sizeof(unsigned long));
+    memcpy(cursor, g->offsets, (n_rows + 1) * sizeof(unsigned long));
+    for (unsigned long i = 0; i < n_edges; i++) {
+        Edge *edge = &edges[by_col[i]];
+        unsigned long slot = cursor[edge->n1]++;
+        g->targets[slot] = edge->n2;
+        g->weights[slot] = edge->weight;
+    }
+
+    free(cursor);
+    free(by_col);
+    free(col_start);
+    graph_build_reverse(g);
+    return g;
+}
+
+Graph *graph_from_flat_matrix(FlatMatrix *fm) {
+    // count first so we only allocate what we need
+    unsigned long n_edges = 0;
+    for (int r = 0; r < fm->height; r++) {
+        for (int c = 0; c < fm->width; c++) {
+            if (flat_matrix_get(fm, r, c)) {
+                n_edges++;
+            }
+        }
+    }
+
+    Graph *g = graph_init(fm->height, fm->width, n_edges);
+    unsigned long e = 0;
+    for (int r = 0; r < fm->height; r++) {
+        for (int c = 0; c < fm->width; c++) {
+            WEIGHT w = flat_matrix_get(fm, r, c);
+            if (w) {
+                g->targets[e] = c;
+                g->weights[e] = w;
+                e++;
+            }
+        }
+        g->offsets[r + 1] = e;
+    }
+    graph_build_reverse(g);
+    return g;
+}
+
+void graph_build_reverse(Graph *g) {
+    if (g->rev_offsets != NULL) {
+        return;
+    }
+    g->rev_offsets = calloc(g->n_cols + 1, sizeof(unsigned long));
+    g->rev_sources = malloc((g->n_edges ? g->n_edges : 1) * sizeof(int));
+    g->rev_weights = malloc((g->n_edges ? g->n_edges : 1) * sizeof(WEIGHT));
+
+    for (unsigned long e = 0; e < g->n_edges; e++) {
+        g->rev_offsets[g->targets[e] + 1]++;
+    }
+    for (int c = 0; c < g->n_cols; c++) {
+        g->rev_offsets[c + 1] += g->rev_offsets[c];
+    }
+
+    // walking the rows in order keeps every column sorted
+    unsigned long *cursor = malloc((g->n_cols + 1) * sizeof(unsigned long));
+    memcpy(cursor, g->rev_offsets, (g->n_cols + 1) * sizeof(unsigned long));
+    for (int r = 0; r < g->n_rows; r++) {
+        for (unsigned long e = g->offsets[r]; e < g->offsets[r + 1]; e++) {
+            unsigned long slot = cursor[g->targets[e]]++;
+            g->rev_sources[slot] = r;
+            g->rev_weights[slot] = g->weights[e];
+        }
+    }
+    free(cursor);
+}
+
+// whether p lives inside the file mapping (and so must not be freed)
+static int is_mapped(Graph *g, void *p) {
+    char *base = g->mapping;
+    return g->mapping != NULL && (char *) p >= base && (char *) p < base + g->mapping_len;
+}
+
+static void free_array(Graph *g, void *p) {
+    if (!is_mapped(g, p)) {
+        free(p);
+    }
+}
+
+void graph_free(Graph *g) {
+    free_array(g, g->offsets);
+    free_array(g, g->targets);
+    free_array(g, g->weights);
+    free_array(g, g->rev_offsets);
+    free_array(g, g->rev_sources);
+    free_array(g, g->rev_weights);
+    free(g->packed);
+    free(g->rev_packed);
+    if (g->mapping != NULL) {
+        munmap(g->mapping, g->mapping_len);
+    }
+    free(g);
+}
+
+void graph_print(Graph *g) {
+    for (int r = 0; r < g->n_rows; r++) {
+        printf("%d:", r);
+        EdgeIter it;
+        graph_out_iter(g, r, &it);
+        int v;
+        WEIGHT w;
+        while (edge_iter_next(&it, &v, &w)) {
+            printf(" %d(%" WEIGHT_FMT ")", v, w);
+        }
+        printf("\n");
+    }
+}
+
+static unsigned char *varint_encode(unsigned char *p, unsigned long x) {
+    while (x >= 0x80) {
+        *p++ = (unsigned char) (x | 0x80);
+        x >>= 7;
+    }
+    *p++ = (unsigned char) x;
+    return p;
+}
+
+static int varint_len(unsigned long x) {
+    int len = 1;
+    while (x >= 0x80) {
+        x >>= 7;
+        len++;
+    }
+    return len;
+}
+
+// packs one direction. offsets/ids/weights are the plain csr arrays, pos gets
+// the byte position of every row
+static unsigned char *pack_rows(int n_rows, unsigned long *offsets, int *ids, WEIGHT *weights,
+        int weight_bytes, unsigned long *pos) {
+    // sizing pass first so the stream is allocated exactly once
+    unsigned long len = 0;
+    for (int r = 0; r < n_rows; r++) {
+        len += varint_len(offsets[r + 1] - offsets[r]);
+        int prev = 0;
+        for (unsigned long e = offsets[r]; e < offsets[r + 1]; e++) {
+            len += varint_len(ids[e] - prev) + weight_bytes;
+            prev = ids[e];
+        }
+    }
+
+    unsigned char *packed = malloc(len ? len : 1);
+    unsigned char *p = packed;
+    for (int r = 0; r < n_rows; r++) {
+        pos[r] = p - packed;
+        p = varint_encode(p, offsets[r + 1] - offsets[r]);
+        int prev = 0;
+        for (unsigned long e = offsets[r]; e < offsets[r + 1]; e++) {
+            p = varint_encode(p, ids[e] - prev);
+            prev = ids[e];
+            unsigned long long w = (unsigned long long) weights[e];
+            for (int b = 0; b < weight_bytes; b++) {
+                *p++ = (unsigned char) (w >> (8 * b));
+            }
+        }
+    }
+    pos[n_rows] = len;
+    return packed;
+}
+
+Graph *graph_pack(Graph *g) {
+    graph_build_reverse(g);
+
+    // negative weights keep the full width so the sign survives
+    WEIGHT min_w = 0, max_w = 0;
+    for (unsigned long e = 0; e < g->n_edges; e++) {
+        if (g->weights[e] < min_w) {
+            min_w = g->weights[e];
+        }
+        if (g->weights[e] > max_w) {
+            max_w = g->weights[e];
+        }
+    }
+    int weight_bytes = sizeof(WEIGHT);
+    if (min_w >= 0) {
+        weight_bytes = 1;
+        while (weight_bytes < (int) sizeof(WEIGHT) && (unsigned long long) max_w >> (8 * weight_bytes) != 0) {
+            weight_bytes *= 2;
+        }
+    }
+
+    Graph *packed = malloc(sizeof(Graph));
+    packed->n_rows = g->n_rows;
+    packed->n_cols = g->n_cols;
+    packed->n_edges = g->n_edges;
+    packed->targets = NULL;
+    packed->weights = NULL;
+    packed->rev_sources = NULL;
+    packed->rev_weights = NULL;
+    packed->weight_bytes = weight_bytes;
+    packed->mapping = NULL;
+    packed->mapping_len = 0;
+    packed->offsets = malloc((g->n_rows + 1) * sizeof(unsigned long));
+    packed->rev_offsets = malloc((g->n_cols + 1) * sizeof(unsigned long));
+    packed->packed = pack_rows(g->n_rows, g->offsets, g->targets, g->weights, weight_bytes, packed->offsets);
+    packed->rev_packed = pack_rows(g->n_cols, g->rev_offsets, g->rev_sources, g->rev_weights, weight_bytes,
+            packed->rev_offsets);
+    return packed;
+}
+
+WEIGHT graph_max_weight(Graph *g) {
+    WEIGHT max_w = 0;
+    for (int r = 0; r < g->n_rows; r++) {
+        EdgeIter it;
+        graph_out_iter(g, r, &it);
+        int v;
+        WEIGHT w;
+        while (edge_iter_next(&it, &v, &w)) {
+            if (w > max_w) {
+                max_w = w;
+            }
+        }
+    }
+    return max_w;
+}
+
+unsigned long graph_bytes(Graph *g) {
+    unsigned long bytes = (g->n_rows + 1) * sizeof(unsigned long);
+    if (g->rev_offsets != NULL) {
+        bytes += (g->n_cols + 1) * sizeof(unsigned long);
+    }
+    if (g->packed != NULL) {
+        return bytes + g->offsets[g->n_rows] + g->rev_offsets[g->n_cols];
+    }
+    bytes += g->n_edges * (sizeof(int) + sizeof(WEIGHT));
+    if (g->rev_offsets != NULL) {
+        bytes += g->n_edges * (sizeof(int) + sizeof(WEIGHT));
+    }
+    return bytes;
+}
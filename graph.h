@@ -0,0 +1,227 @@
+#ifndef __GRAPH_H__
+#define __GRAPH_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "flat_matrix.h"
+
+// a directed edge from n1 to n2
+typedef struct {
+    int n1;
+    int n2;
+    WEIGHT weight;
+} Edge;
+
+// growable edge list, for building up a graph before it is turned into csr
+typedef struct {
+    Edge *edges;
+    unsigned long n_edges;
+    unsigned long capacity;
+} EdgeList;
+
+EdgeList *edge_list_init(unsigned long capacity);
+void edge_list_push(EdgeList *el, int n1, int n2, WEIGHT weight);
+void edge_list_free(EdgeList *el);
+
+// compressed sparse row graph. Row r holds the out edges of vertex r:
+//  targets[offsets[r]] .. targets[offsets[r + 1] - 1], sorted by target,
+//  with the matching weights in weights[].
+// n_rows and n_cols can differ so that a block of rows (e.g. the vertices
+// owned by one MPI proc) can be stored with global column ids.
+//
+// The reverse index is the same edges stored by column (CSC): column c holds
+// the rows with an edge into c, rev_sources[rev_offsets[c]] ..
+// rev_sources[rev_offsets[c + 1] - 1], sorted by row. Our engines are rooted at
+// the destination, so this is the in edge list they walk. It is NULL until
+// graph_build_reverse() is called; the builders below always build it.
+//
+// If the graph came from graph_file_map(), mapping is the mmap'd file and any
+// array that points into it is released with munmap instead of free.
+//
+// A packed graph (see graph_pack) keeps both directions as byte streams
+// instead: every row is a varint degree followed by, for each edge, the varint
+// gap from the previous target (the first gap is from 0) and the weight in
+// weight_bytes little endian bytes. targets, weights, rev_sources and
+// rev_weights are NULL, and offsets / rev_offsets are byte positions into
+// packed / rev_packed. Read the edges of either kind with an EdgeIter.
+typedef struct {
+    int n_rows;
+    int n_cols;
+    unsigned long n_edges;
+    unsigned long *offsets;
+    int *targets;
+    WEIGHT *weights;
+
+    unsigned long *rev_offsets;
+    int *rev_sources;
+    WEIGHT *rev_weights;
+
+    unsigned char *packed;
+    unsigned char *rev_packed;
+    int weight_bytes;
+
+    void *mapping;
+    size_t mapping_len;
+} Graph;
+
+// walks one row (or reverse index column) of a plain or packed graph
+typedef struct {
+    unsigned long left;
+    const int *targets;
+    const WEIGHT *weights;
+    const unsigned char *p;
+    int prev;
+    int weight_bytes;
+} EdgeIter;
+
+// allocates the forward arrays only
+Graph *graph_init(int n_rows, int n_cols, unsigned long n_edges);
+
+// builders, both also build the reverse index. graph_from_edges does not take
+// ownership of the edge list
+Graph *graph_from_edges(int n_rows, int n_cols, Edge *edges, unsigned long n_edges);
+Graph *graph_from_flat_matrix(FlatMatrix *fm);
+
+// builds the reverse index from the forward arrays. Does nothing if it is
+// already there, so engines can call it unconditionally
+void graph_build_reverse(Graph *g);
+
+// a packed copy of g, both directions. g is left alone. Weights get the
+// fewest bytes (1, 2, 4 or 8) that hold every weight in g
+Graph *graph_pack(Graph *g);
+
+// the largest edge weight, 0 for no edges
+WEIGHT graph_max_weight(Graph *g);
+
+// bytes held by the graph arrays, to see what packing saves
+unsigned long graph_bytes(Graph *g);
+
+// LEB128: 7 bits a byte, low bits first, high bit set on all but the last.
+// Unrolled since vertex gaps almost always fit in 3 bytes
+static inline unsigned long varint_decode(const unsigned char **p) {
+    const unsigned char *q = *p;
+    unsigned long x = q[0];
+    if (x < 0x80) {
+        *p = q + 1;
+        return x;
+    }
+    x = (x & 0x7f) | (unsigned long) q[1] << 7;
+    if (q[1] < 0x80) {
+        *p = q + 2;
+        return x;
+    }
+    x = (x & 0x3fff) | (unsigned long) q[2] << 14;
+    if (q[2] < 0x80) {
+        *p = q + 3;
+        return x;
+    }
+    x &= 0x1fffff;
+    int shift = 21;
+    q += 3;
+    unsigned char b;
+    do {
+        b = *q++;
+        x |= (unsigned long) (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    *p = q;
+    return x;
+}
+
+static inline unsigned long graph_degree(Graph *g, int r) {
+    if (g->packed != NULL) {
+        const unsigned char *p = g->packed + g->offsets[r];
+        return varint_decode(&p);
+    }
+    return g->offsets[r + 1] - g->offsets[r];
+}
+
+static inline unsigned long graph_in_degree(Graph *g, int c) {
+    if (g->rev_packed != NULL) {
+        const unsigned char *p = g->rev_packed + g->rev_offsets[c];
+        return varint_decode(&p);
+    }
+    return g->rev_offsets[c + 1] - g->rev_offsets[c];
+}
+
+// out edges of row r
+static inline void graph_out_iter(Graph *g, int r, EdgeIter *it) {
+    // every field set either way, so nothing reads as uninitialized once inlined
+    it->p = NULL;
+    it->targets = NULL;
+    it->weights = NULL;
+    it->prev = 0;
+    it->weight_bytes = 0;
+    if (g->packed != NULL) {
+        it->p = g->packed + g->offsets[r];
+        it->left = varint_decode(&it->p);
+        it->weight_bytes = g->weight_bytes;
+        return;
+    }
+    it->left = g->offsets[r + 1] - g->offsets[r];
+    it->targets = g->targets + g->offsets[r];
+    it->weights = g->weights + g->offsets[r];
+}
+
+// in edges of column c, from the reverse index
+static inline void graph_in_iter(Graph *g, int c, EdgeIter *it) {
+    it->p = NULL;
+    it->targets = NULL;
+    it->weights = NULL;
+    it->prev = 0;
+    it->weight_bytes = 0;
+    if (g->rev_packed != NULL) {
+        it->p = g->rev_packed + g->rev_offsets[c];
+        it->left = varint_decode(&it->p);
+        it->weight_bytes = g->weight_bytes;
+        return;
+    }
+    it->left = g->rev_offsets[c + 1] - g->rev_offsets[c];
+    it->targets = g->rev_sources + g->rev_offsets[c];
+    it->weights = g->rev_weights + g->rev_offsets[c];
+}
+
+// sets *v and *w to the next edge. Returns 0 once the row is done
+static inline int edge_iter_next(EdgeIter *it, int *v, WEIGHT *w) {
+    if (it->left == 0) {
+        return 0;
+    }
+    it->left--;
+    if (it->p == NULL) {
+        *v = *it->targets++;
+        *w = *it->weights++;
+        return 1;
+    }
+    it->prev += (int) varint_decode(&it->p);
+    *v = it->prev;
+    const unsigned char *p = it->p;
+    unsigned long long x;
+    switch (it->weight_bytes) {
+        case 1:
+            x = p[0];
+            break;
+        case 2:
+            x = p[0] | (unsigned) p[1] << 8;
+            break;
+        case 4:
+            x = p[0] | (unsigned) p[1] << 8 | (unsigned long) p[2] << 16 | (unsigned long) p[3] << 24;
+            break;
+        default:
+            x = 0;
+            for (int b = 0; b < it->weight_bytes; b++) {
+                x |= (unsigned long long) p[b] << (8 * b);
+            }
+    }
+    it->p += it->weight_bytes;
+    *w = (WEIGHT) x;
+    return 1;
+}
+
+void graph_free(Graph *g);
+
+void graph_print(Graph *g);
+
+#endif
@@ -0,0 +1,125 @@
+// tool for producing binary graph files (see graph_file.h) that every driver
+// can map directly instead of generating or parsing a graph. Text formats are
+// parsed once here and never again
+#include <math.h>
+
+#include "helpers.h"
+#include "graph_file.h"
+#include "graph_load.h"
+
+static void usage() {
+    printf("Usage: graph_convert [n_nodes] [n_edges] [max_weight] [out_file]\n");
+    printf("       graph_convert -m [matrix_file] [out_file]    (old text .matrix files)\n");
+    printf("       graph_convert -d [dimacs_file] [out_file]    (DIMACS .gr)\n");
+    printf("       graph_convert -e [edge_list] [max_weight] [out_file]    (SNAP style \"u v [w]\" lines)\n");
+    printf("       graph_convert -i [graph_file]\n");
+}
+
+// reads the "%3d " square text matrix that store_matrix_soft used to write
+static Graph *read_text_matrix(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        printf("Could not open file %s\n", filename);
+        return NULL;
+    }
+    unsigned long n_vals = 0;
+    unsigned long capacity = 1024;
+    WEIGHT *vals = malloc(capacity * sizeof(WEIGHT));
+    int val;
+    while (fscanf(fp, "%d", &val) == 1) {
+        if (n_vals == capacity) {
+            capacity *= 2;
+            vals = realloc(vals, capacity * sizeof(WEIGHT));
+        }
+        vals[n_vals++] = val;
+    }
+    fclose(fp);
+
+    int n_nodes = (int) sqrt((double) n_vals);
+    if ((unsigned long) n_nodes * n_nodes != n_vals) {
+        printf("%s does not hold a square matrix (%lu values)\n", filename, n_vals);
+        free(vals);
+        return NULL;
+    }
+
+    unsigned long n_edges = 0;
+    for (unsigned long i = 0; i < n_vals; i++) {
+        if (vals[i]) {
+            n_edges++;
+        }
+    }
+    Edge *edges = malloc((n_edges ? n_edges : 1) * sizeof(Edge));
+    unsigned long e = 0;
+    for (unsigned long i = 0; i < n_vals; i++) {
+        if (vals[i]) {
+            Edge edge = {i / n_nodes, i % n_nodes, vals[i]};
+            edges[e++] = edge;
+        }
+    }
+    free(vals);
+
+    Graph *g = graph_from_edges(n_nodes, n_nodes, edges, n_edges);
+    free(edges);
+    return g;
+}
+
+static int print_info(const char *filename) {
+    GraphFileHeader hdr;
+    if (graph_file_read_header(filename, &hdr) == -1) {
+        return 1;
+    }
+    printf("%s: version %u, %d x %d, %lu edges, max weight %ld, reverse index: %s\n",
+            filename, hdr.version, hdr.n_rows, hdr.n_cols, (unsigned long) hdr.n_edges,
+            (long) hdr.max_weight, (hdr.flags & GRAPH_FILE_HAS_REVERSE) ? "yes" : "no");
+    printf("type sizes: index %u, vertex %u, weight %u\n", hdr.index_size, hdr.vertex_size, hdr.weight_size);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    double start_wall, end_wall, cpu;
+
+    debug_init();
+
+    if (argc == 3 && strcmp(argv[1], "-i") == 0) {
+        return print_info(argv[2]);
+    }
+
+    Graph *g = NULL;
+    char *out_file = NULL;
+    timing(&start_wall, &cpu);
+    if (argc == 4 && strcmp(argv[1], "-m") == 0) {
+        g = read_text_matrix(argv[2]);
+        out_file = argv[3];
+    } else if (argc == 4 && strcmp(argv[1], "-d") == 0) {
+        // thread count comes from OMP_NUM_THREADS
+        g = graph_load_dimacs(argv[2], 0);
+        out_file = argv[3];
+    } else if (argc == 5 && strcmp(argv[1], "-e") == 0) {
+        g = graph_load_edge_list(argv[2], atoi(argv[3]), 0);
+        out_file = argv[4];
+    } else if (argc == 5) {
+        g = gen_graph(atoi(argv[1]), strtoul(argv[2], NULL, 10), atoi(argv[3]));
+        out_file = argv[4];
+    } else {
+        usage();
+        return 1;
+    }
+    if (g == NULL) {
+        return 1;
+    }
+    timing(&end_wall, &cpu);
+    printf("Load time: %.4f\n", end_wall - start_wall);
+
+    timing(&start_wall, &cpu);
+    graph_build_reverse(g);
+    int res = graph_file_write(out_file, g);
+    timing(&end_wall, &cpu);
+    if (res == -1) {
+        graph_free(g);
+        return 1;
+    }
+    printf("Wrote %d nodes, %lu edges to %s in %.4f\n", g->n_rows, g->n_edges, out_file, end_wall - start_wall);
+
+    graph_free(g);
+    return 0;
+}
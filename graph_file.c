@@ -0,0 +1,242 @@
+#define _XOPEN_SOURCE 500
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "graph_file.h"
+
+static uint64_t align_up(uint64_t pos) {
+    return (pos + GRAPH_FILE_ALIGN - 1) / GRAPH_FILE_ALIGN * GRAPH_FILE_ALIGN;
+}
+
+// writes len bytes at pos, zero padding from wherever the file currently is
+static int write_section(FILE *fp, uint64_t pos, const void *data, size_t len) {
+    static const char zeros[GRAPH_FILE_ALIGN] = {0};
+    long cur = ftell(fp);
+    if (cur < 0 || (uint64_t) cur > pos) {
+        return -1;
+    }
+    if (fwrite(zeros, 1, pos - cur, fp) != pos - cur) {
+        return -1;
+    }
+    if (len && fwrite(data, 1, len, fp) != len) {
+        return -1;
+    }
+    return 0;
+}
+
+static int check_header(const GraphFileHeader *hdr, const char *filename) {
+    if (hdr->magic != GRAPH_FILE_MAGIC) {
+        printf("%s is not a graph file\n", filename);
+        return -1;
+    }
+    if (hdr->version != GRAPH_FILE_VERSION) {
+        printf("%s has version %u, expected %u\n", filename, hdr->version, GRAPH_FILE_VERSION);
+        return -1;
+    }
+    return 0;
+}
+
+int graph_file_write(const char *filename, Graph *g) {
+    GraphFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = GRAPH_FILE_MAGIC;
+    hdr.version = GRAPH_FILE_VERSION;
+    hdr.flags = (g->rev_offsets != NULL) ? GRAPH_FILE_HAS_REVERSE : 0;
+    hdr.index_size = sizeof(unsigned long);
+    hdr.vertex_size = sizeof(int);
+    hdr.weight_size = sizeof(WEIGHT);
+    hdr.n_rows = g->n_rows;
+    hdr.n_cols = g->n_cols;
+    hdr.n_edges = g->n_edges;
+    for (unsigned long e = 0; e < g->n_edges; e++) {
+        if (g->weights[e] > hdr.max_weight) {
+            hdr.max_weight = g->weights[e];
+        }
+    }
+
+    size_t offsets_len = (g->n_rows + 1) * sizeof(unsigned long);
+    size_t rev_offsets_len = (g->n_cols + 1) * sizeof(unsigned long);
+    size_t targets_len = g->n_edges * sizeof(int);
+    size_t weights_len = g->n_edges * sizeof(WEIGHT);
+
+    hdr.offsets_pos = align_up(sizeof(hdr));
+    hdr.targets_pos = align_up(hdr.offsets_pos + offsets_len);
+    hdr.weights_pos = align_up(hdr.targets_pos + targets_len);
+    if (hdr.flags & GRAPH_FILE_HAS_REVERSE) {
+        hdr.rev_offsets_pos = align_up(hdr.weights_pos + weights_len);
+        hdr.rev_sources_pos = align_up(hdr.rev_offsets_pos + rev_offsets_len);
+        hdr.rev_weights_pos = align_up(hdr.rev_sources_pos + targets_len);
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        printf("Could not open file %s\n", filename);
+        return -1;
+    }
+    int res = 0;
+    res |= write_section(fp, 0, &hdr, sizeof(hdr));
+    res |= write_section(fp, hdr.offsets_pos, g->offsets, offsets_len);
+    res |= write_section(fp, hdr.targets_pos, g->targets, targets_len);
+    res |= write_section(fp, hdr.weights_pos, g->weights, weights_len);
+    if (hdr.flags & GRAPH_FILE_HAS_REVERSE) {
+        res |= write_section(fp, hdr.rev_offsets_pos, g->rev_offsets, rev_offsets_len);
+        res |= write_section(fp, hdr.rev_sources_pos, g->rev_sources, targets_len);
+        res |= write_section(fp, hdr.rev_weights_pos, g->rev_weights, weights_len);
+    }
+    if (fclose(fp) != 0) {
+        res = -1;
+    }
+    if (res) {
+        printf("Error writing graph file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int graph_file_read_header(const char *filename, GraphFileHeader *hdr) {
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        printf("Could not open file %s\n", filename);
+        return -1;
+    }
+    size_t got = fread(hdr, sizeof(GraphFileHeader), 1, fp);
+    fclose(fp);
+    if (got != 1) {
+        printf("%s is too short to be a graph file\n", filename);
+        return -1;
+    }
+    return check_header(hdr, filename);
+}
+
+Graph *graph_file_map(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        printf("Could not open file %s\n", filename);
+        return NULL;
+    }
+    struct stat fstat_buf;
+    if (fstat(fd, &fstat_buf) == -1 || (size_t) fstat_buf.st_size < sizeof(GraphFileHeader)) {
+        printf("%s is too short to be a graph file\n", filename);
+        close(fd);
+        return NULL;
+    }
+    size_t len = fstat_buf.st_size;
+    char *base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file alive on its own
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("Could not mmap %s\n", filename);
+        return NULL;
+    }
+
+    GraphFileHeader *hdr = (GraphFileHeader *) base;
+    if (check_header(hdr, filename) == -1) {
+        munmap(base, len);
+        return NULL;
+    }
+    if (hdr->index_size != sizeof(unsigned long)
+            || hdr->vertex_size != sizeof(int)
+            || hdr->weight_size != sizeof(WEIGHT)) {
+        printf("%s was written with different type sizes (index %u, vertex %u, weight %u)\n",
+                filename, hdr->index_size, hdr->vertex_size, hdr->weight_size);
+        munmap(base, len);
+        return NULL;
+    }
+    uint64_t end = hdr->weights_pos + hdr->n_edges * sizeof(WEIGHT);
+    if (hdr->flags & GRAPH_FILE_HAS_REVERSE) {
+        end = hdr->rev_weights_pos + hdr->n_edges * sizeof(WEIGHT);
+    }
+    if (end > len) {
+        printf("%s is truncated\n", filename);
+        munmap(base, len);
+        return NULL;
+    }
+
+    Graph *g = malloc(sizeof(Graph));
+    g->n_rows = hdr->n_rows;
+    g->n_cols = hdr->n_cols;
+    g->n_edges = hdr->n_edges;
+    g->mapping = base;
+    g->mapping_len = len;
+    // the graph is read-only from here on, the casts just drop the const
+    g->offsets = (unsigned long *) (base + hdr->offsets_pos);
+    g->targets = (int *) (base + hdr->targets_pos);
+    g->weights = (WEIGHT *) (base + hdr->weights_pos);
+    g->rev_offsets = NULL;
+    g->rev_sources = NULL;
+    g->rev_weights = NULL;
+    g->packed = NULL;
+    g->rev_packed = NULL;
+    g->weight_bytes = sizeof(WEIGHT);
+    if (hdr->flags & GRAPH_FILE_HAS_REVERSE) {
+        g->rev_offsets = (unsigned long *) (base + hdr->rev_offsets_pos);
+        g->rev_sources = (int *) (base + hdr->rev_sources_pos);
+        g->rev_weights = (WEIGHT *) (base + hdr->rev_weights_pos);
+    } else {
+        graph_build_reverse(g);
+    }
+    return g;
+}
+
+static int read_at(int fd, void *buf, size_t len, uint64_t pos) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t got = pread(fd, p, len, pos);
+        if (got <= 0) {
+            return -1;
+        }
+        p += got;
+        len -= got;
+        pos += got;
+    }
+    return 0;
+}
+
+Graph *graph_file_read_rows(const char *filename, int row_lo, int row_hi) {
+    GraphFileHeader hdr;
+    if (graph_file_read_header(filename, &hdr) == -1) {
+        return NULL;
+    }
+    if (hdr.index_size != sizeof(unsigned long)
+            || hdr.vertex_size != sizeof(int)
+            || hdr.weight_size != sizeof(WEIGHT)) {
+        printf("%s was written with different type sizes (index %u, vertex %u, weight %u)\n",
+                filename, hdr.index_size, hdr.vertex_size, hdr.weight_size);
+        return NULL;
+    }
+    if (row_lo < 0 || row_hi > hdr.n_rows || row_lo > row_hi) {
+        printf("%s has no rows [%d, %d)\n", filename, row_lo, row_hi);
+        return NULL;
+    }
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        printf("Could not open file %s\n", filename);
+        return NULL;
+    }
+
+    int n_rows = row_hi - row_lo;
+    unsigned long *offsets = malloc((n_rows + 1) * sizeof(unsigned long));
+    Graph *g = NULL;
+    if (read_at(fd, offsets, (n_rows + 1) * sizeof(unsigned long),
+                hdr.offsets_pos + (uint64_t) row_lo * sizeof(unsigned long)) == 0) {
+        unsigned long first = offsets[0];
+        unsigned long n_edges = offsets[n_rows] - first;
+        g = graph_init(n_rows, hdr.n_cols, n_edges);
+        for (int r = 0; r <= n_rows; r++) {
+            g->offsets[r] = offsets[r] - first;
+        }
+        if (read_at(fd, g->targets, n_edges * sizeof(int), hdr.targets_pos + first * sizeof(int)) == -1
+                || read_at(fd, g->weights, n_edges * sizeof(WEIGHT), hdr.weights_pos + first * sizeof(WEIGHT)) == -1) {
+            graph_free(g);
+            g = NULL;
+        }
+    }
+    free(offsets);
+    close(fd);
+    if (g == NULL) {
+        printf("%s is truncated\n", filename);
+    }
+    return g;
+}
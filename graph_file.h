@@ -0,0 +1,58 @@
+#ifndef __GRAPH_FILE_H__
+#define __GRAPH_FILE_H__
+
+#include <stdint.h>
+
+#include "graph.h"
+
+// binary graph container. The sections are laid out exactly like the Graph
+// arrays in memory, so a mapped file is used in place without parsing:
+//
+//   header | offsets | targets | weights | [rev_offsets | rev_sources | rev_weights]
+//
+// every section starts on a GRAPH_FILE_ALIGN boundary and the *_pos fields
+// are byte offsets from the start of the file. A file can only be mapped by a
+// build whose index/vertex/weight sizes match the ones recorded in the header.
+#define GRAPH_FILE_MAGIC 0x48505247 // "GRPH"
+#define GRAPH_FILE_VERSION 1
+#define GRAPH_FILE_ALIGN 64
+
+#define GRAPH_FILE_HAS_REVERSE 0x1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t index_size;
+    uint32_t vertex_size;
+    uint32_t weight_size;
+    int32_t n_rows;
+    int32_t n_cols;
+    uint64_t n_edges;
+    int64_t max_weight;
+
+    uint64_t offsets_pos;
+    uint64_t targets_pos;
+    uint64_t weights_pos;
+    uint64_t rev_offsets_pos;
+    uint64_t rev_sources_pos;
+    uint64_t rev_weights_pos;
+} GraphFileHeader;
+
+// returns 0 on success, -1 on failure. Writes the reverse index if g has one
+int graph_file_write(const char *filename, Graph *g);
+
+// returns 0 on success, -1 if the file can't be read or isn't a graph file
+int graph_file_read_header(const char *filename, GraphFileHeader *hdr);
+
+// maps the file read-only and points the graph arrays straight into it.
+// The reverse index is built (in ordinary memory) if the file has none.
+// Returns NULL on failure
+Graph *graph_file_map(const char *filename);
+
+// reads just rows [row_lo, row_hi) into ordinary memory, as a block of rows
+// with global column ids. Nothing else in the file is touched. The reverse
+// index is not built. Returns NULL on failure
+Graph *graph_file_read_rows(const char *filename, int row_lo, int row_hi);
+
+#endif
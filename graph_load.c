@@ -0,0 +1,262 @@
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "helpers.h"
+#include "graph_load.h"
+#include "rng.h"
+
+// how much of the file we hold at once
+#define LOAD_BLOCK_BYTES (64UL << 20)
+
+typedef enum {
+    FORMAT_DIMACS,
+    FORMAT_EDGE_LIST,
+} FORMAT;
+
+// everything one thread has parsed so far. These live across blocks
+typedef struct {
+    EdgeList *el;
+    long max_id;
+    long header_nodes;
+    unsigned long bad_lines;
+} LoadState;
+
+static const char *skip_space(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+// returns a pointer past the number, or NULL if there wasn't one
+static const char *parse_long(const char *p, const char *end, long *out) {
+    p = skip_space(p, end);
+    int neg = 0;
+    if (p < end && *p == '-') {
+        neg = 1;
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+    long val = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        val = val * 10 + (*p - '0');
+        p++;
+    }
+    *out = neg ? -val : val;
+    return p;
+}
+
+static void push_edge(LoadState *st, long u, long v, long w) {
+    edge_list_push(st->el, u, v, w);
+    if (u > st->max_id) {
+        st->max_id = u;
+    }
+    if (v > st->max_id) {
+        st->max_id = v;
+    }
+}
+
+static void parse_line(const char *p, const char *end, FORMAT fmt, int max_weight, LoadState *st) {
+    p = skip_space(p, end);
+    if (p == end) {
+        return;
+    }
+    long u, v, w;
+    if (fmt == FORMAT_DIMACS) {
+        if (*p == 'c') {
+            return;
+        }
+        if (*p == 'p') {
+            // "p sp n m", skip over the problem type
+            p = skip_space(p + 1, end);
+            while (p < end && *p != ' ' && *p != '\t') {
+                p++;
+            }
+            if (parse_long(p, end, &u) == NULL) {
+                st->bad_lines++;
+                return;
+            }
+            st->header_nodes = u;
+            return;
+        }
+        if (*p != 'a'
+                || (p = parse_long(p + 1, end, &u)) == NULL
+                || (p = parse_long(p, end, &v)) == NULL
+                || parse_long(p, end, &w) == NULL
+                || u < 1 || v < 1) {
+            st->bad_lines++;
+            return;
+        }
+        push_edge(st, u - 1, v - 1, w);
+        return;
+    }
+
+    if (*p == '#' || *p == '%') {
+        return;
+    }
+    if ((p = parse_long(p, end, &u)) == NULL
+            || (p = parse_long(p, end, &v)) == NULL
+            || u < 0 || v < 0) {
+        st->bad_lines++;
+        return;
+    }
+    if (parse_long(p, end, &w) == NULL) {
+        w = 1;
+        if (max_weight > 1) {
+            w = mix64(((unsigned long long) u << 32 ^ v) + SEED) % max_weight + 1;
+        }
+    }
+    push_edge(st, u, v, w);
+}
+
+// first line start at or after pos
+static size_t line_start(const char *buf, size_t len, size_t pos) {
+    while (pos > 0 && pos < len && buf[pos - 1] != '\n') {
+        pos++;
+    }
+    return pos;
+}
+
+static void parse_block(const char *buf, size_t len, FORMAT fmt, int max_weight, LoadState *states, int n_threads) {
+    #pragma omp parallel num_threads(n_threads)
+    {
+        int t = 0;
+        int nt = 1;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+        nt = omp_get_num_threads();
+#endif
+        // every thread works out the same boundaries, so no one has to hand them out
+        size_t start = line_start(buf, len, len / nt * t);
+        size_t stop = (t == nt - 1) ? len : line_start(buf, len, len / nt * (t + 1));
+        const char *p = buf + start;
+        const char *end = buf + stop;
+        while (p < end) {
+            const char *eol = memchr(p, '\n', end - p);
+            if (eol == NULL) {
+                eol = end;
+            }
+            parse_line(p, eol, fmt, max_weight, &states[t]);
+            p = eol + 1;
+        }
+    }
+}
+
+static Graph *load_text_graph(const char *filename, FORMAT fmt, int max_weight, int n_threads) {
+    double start_wall, parsed_wall, end_wall, cpu;
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        printf("Could not open file %s\n", filename);
+        return NULL;
+    }
+
+#ifdef _OPENMP
+    if (n_threads <= 0) {
+        n_threads = omp_get_max_threads();
+    }
+#else
+    n_threads = 1;
+#endif
+    LoadState *states = calloc(n_threads, sizeof(LoadState));
+    for (int t = 0; t < n_threads; t++) {
+        states[t].el = edge_list_init(4096);
+        states[t].max_id = -1;
+        states[t].header_nodes = -1;
+    }
+
+    timing(&start_wall, &cpu);
+    size_t capacity = LOAD_BLOCK_BYTES;
+    char *buf = malloc(capacity);
+    size_t len = 0;
+    unsigned long total_bytes = 0;
+    while (1) {
+        size_t got = fread(buf + len, 1, capacity - len, fp);
+        len += got;
+        int at_eof = (got == 0);
+
+        // only hand out whole lines; the tail waits for the next block
+        size_t parse_len = len;
+        if (!at_eof) {
+            while (parse_len > 0 && buf[parse_len - 1] != '\n') {
+                parse_len--;
+            }
+            if (parse_len == 0) {
+                // one line bigger than the whole buffer
+                capacity *= 2;
+                buf = realloc(buf, capacity);
+                continue;
+            }
+        }
+
+        parse_block(buf, parse_len, fmt, max_weight, states, n_threads);
+        total_bytes += parse_len;
+        memmove(buf, buf + parse_len, len - parse_len);
+        len -= parse_len;
+        if (at_eof) {
+            break;
+        }
+    }
+    free(buf);
+    fclose(fp);
+    timing(&parsed_wall, &cpu);
+
+    // gather everything up into one edge list
+    unsigned long n_edges = 0;
+    unsigned long bad_lines = 0;
+    long max_id = -1;
+    long header_nodes = -1;
+    for (int t = 0; t < n_threads; t++) {
+        n_edges += states[t].el->n_edges;
+        bad_lines += states[t].bad_lines;
+        if (states[t].max_id > max_id) {
+            max_id = states[t].max_id;
+        }
+        if (states[t].header_nodes != -1) {
+            header_nodes = states[t].header_nodes;
+        }
+    }
+    Edge *edges = malloc((n_edges ? n_edges : 1) * sizeof(Edge));
+    unsigned long e = 0;
+    for (int t = 0; t < n_threads; t++) {
+        memcpy(edges + e, states[t].el->edges, states[t].el->n_edges * sizeof(Edge));
+        e += states[t].el->n_edges;
+        edge_list_free(states[t].el);
+    }
+    free(states);
+
+    if (bad_lines) {
+        printf("WARNING: skipped %lu malformed lines in %s\n", bad_lines, filename);
+    }
+    long n_nodes = max_id + 1;
+    if (fmt == FORMAT_DIMACS) {
+        if (header_nodes == -1 || max_id >= header_nodes) {
+            printf("%s has no \"p\" line or an arc past its node count\n", filename);
+            free(edges);
+            return NULL;
+        }
+        n_nodes = header_nodes;
+    }
+
+    Graph *g = graph_from_edges(n_nodes, n_nodes, edges, n_edges);
+    free(edges);
+    timing(&end_wall, &cpu);
+
+    double mb = total_bytes / (1024.0 * 1024.0);
+    double parse_time = parsed_wall - start_wall;
+    printf("Parsed %s: %.1f MB, %ld nodes, %lu edges in %.3f s (%.1f MB/s) on %d threads, CSR build %.3f s\n",
+            filename, mb, n_nodes, n_edges, parse_time, parse_time > 0 ? mb / parse_time : 0.0,
+            n_threads, end_wall - parsed_wall);
+    return g;
+}
+
+Graph *graph_load_dimacs(const char *filename, int n_threads) {
+    return load_text_graph(filename, FORMAT_DIMACS, 0, n_threads);
+}
+
+Graph *graph_load_edge_list(const char *filename, int max_weight, int n_threads) {
+    return load_text_graph(filename, FORMAT_EDGE_LIST, max_weight, n_threads);
+}
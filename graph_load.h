@@ -0,0 +1,21 @@
+#ifndef __GRAPH_LOAD_H__
+#define __GRAPH_LOAD_H__
+
+#include "graph.h"
+
+// streaming loaders for text graph formats. The file is read in blocks and
+// every block is split at line boundaries across n_threads OpenMP threads
+// (0 means the OpenMP default). Edges go straight into the CSR graph, there
+// is never an n x n matrix. Parse throughput is printed when done.
+
+// DIMACS shortest path format (.gr): "c" comment lines, one "p sp n m" line
+// and "a u v w" arc lines with 1-based vertex ids
+Graph *graph_load_dimacs(const char *filename, int n_threads);
+
+// whitespace separated edge list as used by SNAP: "#" comment lines and
+// "u v [w]" lines with 0-based vertex ids. n_nodes is the largest id + 1.
+// Lines without a weight get one in 1..max_weight hashed from (u, v, SEED),
+// or 1 if max_weight < 2, so the same file always gives the same graph
+Graph *graph_load_edge_list(const char *filename, int max_weight, int n_threads);
+
+#endif
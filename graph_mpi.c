@@ -0,0 +1,230 @@
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "graph_mpi.h"
+#include "graph_file.h"
+#include "helpers.h"
+
+static const char *THREAD_LEVEL_NAMES[] = {"single", "funneled", "serialized", "multiple"};
+static const int THREAD_LEVELS[] = {MPI_THREAD_SINGLE, MPI_THREAD_FUNNELED, MPI_THREAD_SERIALIZED, MPI_THREAD_MULTIPLE};
+
+static const char *thread_level_name(int level) {
+    for (int i = 0; i < 4; i++) {
+        if (THREAD_LEVELS[i] == level) {
+            return THREAD_LEVEL_NAMES[i];
+        }
+    }
+    return "unknown";
+}
+
+int mpi_init_threads(int *argc, char ***argv) {
+    int wanted = MPI_THREAD_FUNNELED;
+    char *name = getenv("MPI_THREADS");
+    int known = name == NULL;
+    for (int i = 0; i < 4 && !known; i++) {
+        if (strcmp(name, THREAD_LEVEL_NAMES[i]) == 0) {
+            wanted = THREAD_LEVELS[i];
+            known = 1;
+        }
+    }
+    int provided;
+    MPI_Init_thread(argc, argv, wanted, &provided);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        if (!known) {
+            printf("WARNING: unknown MPI_THREADS %s, using funneled\n", name);
+        }
+        if (provided < wanted) {
+            printf("WARNING: asked MPI for thread level %s but only got %s\n",
+                    thread_level_name(wanted), thread_level_name(provided));
+        }
+        int n_threads = 1;
+#ifdef _OPENMP
+        n_threads = omp_get_max_threads();
+#endif
+        printf("MPI thread level %s, %d OpenMP threads per rank\n", thread_level_name(provided), n_threads);
+    }
+    return provided;
+}
+
+Graph *graph_load_rows(char *graph_file, int n_nodes, unsigned long n_edges, int max_weight, int row_lo, int row_hi) {
+    if (graph_file != NULL) {
+        return graph_file_read_rows(graph_file, row_lo, row_hi);
+    }
+    return gen_graph_rows(n_nodes, n_edges, max_weight, row_lo, row_hi);
+}
+
+Edge *graph_exchange_edges(Edge *edges, int *dests, unsigned long n_edges, unsigned long *n_recv, MPI_Comm comm) {
+    int n_procs;
+    MPI_Comm_size(comm, &n_procs);
+
+    MPI_Datatype edge_type;
+    MPI_Type_contiguous(sizeof(Edge), MPI_BYTE, &edge_type);
+    MPI_Type_commit(&edge_type);
+
+    int *send_counts = calloc(n_procs, sizeof(int));
+    int *send_displs = calloc(n_procs, sizeof(int));
+    int *recv_counts = calloc(n_procs, sizeof(int));
+    int *recv_displs = calloc(n_procs, sizeof(int));
+    for (unsigned long e = 0; e < n_edges; e++) {
+        send_counts[dests[e]]++;
+    }
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+    *n_recv = recv_counts[0];
+    for (int p = 1; p < n_procs; p++) {
+        send_displs[p] = send_displs[p - 1] + send_counts[p - 1];
+        recv_displs[p] = recv_displs[p - 1] + recv_counts[p - 1];
+        *n_recv += recv_counts[p];
+    }
+
+    // group by destination
+    Edge *send_edges = malloc((n_edges ? n_edges : 1) * sizeof(Edge));
+    int *cursor = malloc(n_procs * sizeof(int));
+    memcpy(cursor, send_displs, n_procs * sizeof(int));
+    for (unsigned long e = 0; e < n_edges; e++) {
+        send_edges[cursor[dests[e]]++] = edges[e];
+    }
+
+    Edge *recv_edges = malloc((*n_recv ? *n_recv : 1) * sizeof(Edge));
+    MPI_Alltoallv(send_edges, send_counts, send_displs, edge_type,
+            recv_edges, recv_counts, recv_displs, edge_type, comm);
+
+    free(send_edges);
+    free(cursor);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+    MPI_Type_free(&edge_type);
+    return recv_edges;
+}
+
+Graph *graph_redistribute(Graph *block, Partition *from, Partition *to, MPI_Comm comm) {
+    // edges go over the wire with global ids and get their local row on arrival
+    Edge *edges = malloc((block->n_edges ? block->n_edges : 1) * sizeof(Edge));
+    int *dests = malloc((block->n_edges ? block->n_edges : 1) * sizeof(int));
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int r = 0; r < from->n_local; r++) {
+        int v = from->local_nodes[r];
+        for (unsigned long e = block->offsets[r]; e < block->offsets[r + 1]; e++) {
+            Edge edge = {v, block->targets[e], block->weights[e]};
+            edges[e] = edge;
+            dests[e] = to->owner[v];
+        }
+    }
+    unsigned long n_recv;
+    Edge *recv = graph_exchange_edges(edges, dests, block->n_edges, &n_recv, comm);
+    free(edges);
+    free(dests);
+
+    for (unsigned long e = 0; e < n_recv; e++) {
+        recv[e].n1 = to->local_idx[recv[e].n1];
+    }
+    Graph *g = graph_from_edges(to->n_local, block->n_cols, recv, n_recv);
+    free(recv);
+    return g;
+}
+
+Graph *graph_in_edges(Graph *block, Partition *part, MPI_Comm comm) {
+    // n1 is the target's local row on its owner, n2 the global source
+    Edge *edges = malloc((block->n_edges ? block->n_edges : 1) * sizeof(Edge));
+    int *dests = malloc((block->n_edges ? block->n_edges : 1) * sizeof(int));
+    // every row fills its own slice of edges[], so the threads split the rows
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int r = 0; r < part->n_local; r++) {
+        for (unsigned long e = block->offsets[r]; e < block->offsets[r + 1]; e++) {
+            int target = block->targets[e];
+            Edge edge = {part->local_idx[target], part->local_nodes[r], block->weights[e]};
+            edges[e] = edge;
+            dests[e] = part->owner[target];
+        }
+    }
+    unsigned long n_recv;
+    Edge *recv = graph_exchange_edges(edges, dests, block->n_edges, &n_recv, comm);
+    free(edges);
+    free(dests);
+
+    Graph *in = graph_from_edges(part->n_local, block->n_cols, recv, n_recv);
+    free(recv);
+    return in;
+}
+
+Graph *graph_load_partitioned(char *graph_file, int n_nodes, unsigned long n_edges, int max_weight,
+        Partition **part, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    Partition *rows = partition_block(n_nodes, comm);
+    int row_lo = rows->n_local ? rows->local_nodes[0] : 0;
+    Graph *block = graph_load_rows(graph_file, n_nodes, n_edges, max_weight, row_lo, row_lo + rows->n_local);
+    int ok = (block != NULL);
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    if (!all_ok) {
+        if (block != NULL) {
+            graph_free(block);
+        }
+        partition_free(rows);
+        return NULL;
+    }
+
+    PARTITION_KIND kind = partition_kind_from_env();
+    unsigned long cut = partition_edge_cut(block, rows, rows, comm);
+    Graph *mine = block;
+    if (kind == PARTITION_BLOCK) {
+        *part = rows;
+    } else {
+        *part = partition_edges(block, rows, comm);
+        if (kind == PARTITION_LABEL_PROP) {
+            Partition *start = *part;
+            Graph *start_block = graph_redistribute(block, rows, start, comm);
+            Graph *start_in = graph_in_edges(start_block, start, comm);
+            *part = partition_label_prop(start_block, start_in, start, comm);
+            graph_free(start_in);
+            graph_free(start_block);
+            partition_free(start);
+        }
+        unsigned long new_cut = partition_edge_cut(block, rows, *part, comm);
+        mine = graph_redistribute(block, rows, *part, comm);
+        graph_free(block);
+        partition_free(rows);
+        if (rank == 0) {
+            printf("Partition %s: edge cut %lu -> %lu\n", partition_kind_name(kind), cut, new_cut);
+        }
+    }
+
+    // how even the work came out
+    unsigned long local_edges = mine->n_edges;
+    unsigned long max_edges, total_edges;
+    MPI_Reduce(&local_edges, &max_edges, 1, MPI_UNSIGNED_LONG, MPI_MAX, 0, comm);
+    MPI_Reduce(&local_edges, &total_edges, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
+    if (rank == 0) {
+        int n_procs = (*part)->n_procs;
+        printf("Partition %s: max edges per rank %lu (%.2fx average)\n", partition_kind_name(kind), max_edges,
+                total_edges ? (double) max_edges * n_procs / total_edges : 1.0);
+    }
+    return mine;
+}
+
+Graph *graph_pack_if_asked(Graph *block, MPI_Comm comm) {
+    if (!packing_from_env()) {
+        return block;
+    }
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    unsigned long local[2], total[2];
+    local[0] = graph_bytes(block);
+    Graph *packed = graph_pack(block);
+    graph_free(block);
+    local[1] = graph_bytes(packed);
+    MPI_Reduce(local, total, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
+    if (rank == 0) {
+        printf("Packed graph: %.1f MB -> %.1f MB over all procs (%.2fx smaller)\n",
+                total[0] / 1e6, total[1] / 1e6, (double) total[0] / total[1]);
+    }
+    return packed;
+}
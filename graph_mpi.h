@@ -0,0 +1,56 @@
+#ifndef __GRAPH_MPI_H__
+#define __GRAPH_MPI_H__
+
+#include <mpi.h>
+
+#include "graph.h"
+#include "partition.h"
+
+// the mpi type matching WEIGHT
+#ifdef WEIGHT_64
+#define MPI_WEIGHT MPI_LONG_LONG
+#else
+#define MPI_WEIGHT MPI_INT
+#endif
+
+// MPI_Init_thread at the level the MPI_THREADS environment variable asks for:
+// single, funneled (the default), serialized or multiple. The engines run
+// one rank per socket or node with OpenMP threads doing the local loops, and
+// only ever call MPI from the master thread outside parallel regions, so
+// funneled is all they need; the others are there to try what the MPI
+// library does with them. Warns if the library gives us less than we asked
+// for and returns the level provided
+int mpi_init_threads(int *argc, char ***argv);
+
+// loads rows [row_lo, row_hi), either from that slice of graph_file or by
+// generating just those rows (graph_file NULL). The block keeps global
+// column ids. Returns NULL on failure
+Graph *graph_load_rows(char *graph_file, int n_nodes, unsigned long n_edges, int max_weight, int row_lo, int row_hi);
+
+// every proc loads a plain block of rows, the partitioner picked by the
+// PARTITION environment variable decides who owns what, and the rows get
+// shipped to their owners. Returns this proc's rows (local_nodes order) and
+// sets *part. No proc ever holds more than its share plus O(n) metadata.
+// Collective, returns NULL on failure
+Graph *graph_load_partitioned(char *graph_file, int n_nodes, unsigned long n_edges, int max_weight,
+        Partition **part, MPI_Comm comm);
+
+// block holds the rows of from; returns the same graph's rows under to
+Graph *graph_redistribute(Graph *block, Partition *from, Partition *to, MPI_Comm comm);
+
+// sends edges[i] to rank dests[i] in one all-to-all and returns everything
+// sent to us, *n_recv edges grouped by sender. The engines also use it to
+// ship batches of relaxation requests. Collective over comm
+Edge *graph_exchange_edges(Edge *edges, int *dests, unsigned long n_edges, unsigned long *n_recv, MPI_Comm comm);
+
+// the in edges of a proc's own vertices live in everyone else's row blocks,
+// so they get shipped to their owner here. Row r of the result holds the
+// sources (global ids, sorted) of the edges into local vertex r, with their
+// weights. Collective over comm
+Graph *graph_in_edges(Graph *block, Partition *part, MPI_Comm comm);
+
+// graph_pack for the local block when GRAPH_STORAGE=packed, printing the
+// savings summed over every proc. Collective
+Graph *graph_pack_if_asked(Graph *block, MPI_Comm comm);
+
+#endif
@@ -3,43 +3,83 @@
 // returns a randomly generated graph using those parameters
 // right now we're using integer weights
 #include "helpers.h"
+#include "graph_file.h"
+#include "generators.h"
 
-FlatMatrix *gen_graph(int n_nodes, unsigned long n_edges, int max_weight) {
+Graph *gen_graph(int n_nodes, unsigned long n_edges, int max_weight) {
 
-    unsigned long max_edges = (n_nodes - 1) * n_nodes; // max number of DIRECTED edges
+    // graphs are deterministic under SEED, so reuse the one we stored last time
+    Graph *g = read_graph(SEED, n_nodes, n_edges, max_weight);
+    if (g != NULL) {
+        return g;
+    }
+
+    unsigned long max_edges = (unsigned long) (n_nodes - 1) * n_nodes; // max number of DIRECTED edges
     if (n_edges > max_edges) {
         printf("Too many edges!\n");
         return NULL;
     }
-    srand(SEED);
-    // initialize the adjacency matrix as a 2-D array
-    FlatMatrix *adj_matrix = flat_matrix_init(n_nodes, n_nodes);
-
-    // now we randomly select the adjacencies to put in the matrix
-    unsigned long e = 0;
-    while (e < n_edges) {
-        // this isn't uniform but it sohuld suffice for our purposes
-        int n1 = (int) rand()*1.0 / RAND_MAX * n_nodes;
-        int n2 = (int) rand()*1.0 / RAND_MAX * n_nodes;
-
-
-        // don't want to repeat an edge or put an edge between the same nodes
-        if (n1 == n2
-                || flat_matrix_get(adj_matrix, n1, n2) != 0) {
-            continue;
-        }
-
-        // generate the weights, from 1 til max_weight (inclusive)
-        WEIGHT weight = (WEIGHT) (rand() * 1.0 / RAND_MAX * max_weight) + 1;
 
-        flat_matrix_set(adj_matrix, n1, n2, weight);
-        e++;
+    // the model comes from GRAPH_MODEL, see generators.h
+    GRAPH_MODEL model = graph_model_from_env();
+    EdgeList *el = gen_edges(model, n_nodes, n_edges, max_weight, 0, n_nodes);
+    if (el->n_edges != n_edges) {
+        printf("INFO: %s graph has %lu edges (asked for %lu)\n", graph_model_name(model), el->n_edges, n_edges);
     }
+    g = graph_from_edges(n_nodes, n_nodes, el->edges, el->n_edges);
+    edge_list_free(el);
 
     // write this out
-    store_matrix_soft(SEED, n_nodes, n_edges, max_weight, adj_matrix);
+    store_graph_soft(SEED, n_nodes, n_edges, max_weight, g);
+
+    return g;
+}
+
+Graph *gen_graph_rows(int n_nodes, unsigned long n_edges, int max_weight, int row_lo, int row_hi) {
+    unsigned long max_edges = (unsigned long) (n_nodes - 1) * n_nodes;
+    if (n_edges > max_edges) {
+        printf("Too many edges!\n");
+        return NULL;
+    }
+
+    // the generators give every row the same edges whichever range it is
+    // made in, so this block matches the same rows of gen_graph()
+    EdgeList *el = gen_edges(graph_model_from_env(), n_nodes, n_edges, max_weight, row_lo, row_hi);
+    for (unsigned long e = 0; e < el->n_edges; e++) {
+        el->edges[e].n1 -= row_lo;
+    }
+    Graph *g = graph_from_edges(row_hi - row_lo, n_nodes, el->edges, el->n_edges);
+    edge_list_free(el);
+    return g;
+}
+
+int parse_graph_args(int argc, char **argv, char **graph_file, int *n_nodes, unsigned long *n_edges, int *max_weight) {
+    if (argc == 2) {
+        GraphFileHeader hdr;
+        if (graph_file_read_header(argv[1], &hdr) == -1) {
+            return -1;
+        }
+        *graph_file = argv[1];
+        *n_nodes = hdr.n_rows;
+        *n_edges = hdr.n_edges;
+        *max_weight = hdr.max_weight;
+        return 0;
+    }
+    if (argc == 4) {
+        *graph_file = NULL;
+        *n_nodes = atoi(argv[1]);
+        *n_edges = strtoul(argv[2], NULL, 10);
+        *max_weight = atoi(argv[3]);
+        return 0;
+    }
+    return -1;
+}
 
-    return adj_matrix;
+Graph *load_graph(char *graph_file, int n_nodes, unsigned long n_edges, int max_weight) {
+    if (graph_file != NULL) {
+        return graph_file_map(graph_file);
+    }
+    return gen_graph(n_nodes, n_edges, max_weight);
 }
 
 
@@ -83,11 +123,47 @@ void timing(double* wcTime, double* cpuTime)
 
 // error norm. I guess we'll use l2
 double l2_norm(WEIGHT *arr1, WEIGHT *arr2, int len) {
-    WEIGHT err = 0;
+    // in doubles, the squares blow past any int type (unreachable is WEIGHT_MAX)
+    double err = 0;
     for (int i = 0; i < len; i++) {
-        err += (arr1[i] - arr2[i]) * (arr1[i] - arr2[i]);
+        double diff = (double) arr1[i] - (double) arr2[i];
+        err += diff * diff;
+    }
+    return sqrt(err);
+}
+
+int packing_from_env() {
+    char *storage = getenv("GRAPH_STORAGE");
+    if (storage == NULL || strcmp(storage, "plain") == 0) {
+        return 0;
+    }
+    if (strcmp(storage, "packed") != 0) {
+        printf("WARNING: unknown GRAPH_STORAGE %s, using plain\n", storage);
+        return 0;
+    }
+    return 1;
+}
+
+WEIGHT pick_delta(WEIGHT max_weight, int n_nodes, unsigned long n_edges) {
+    char *env = getenv("DELTA");
+    if (env != NULL && atoll(env) > 0) {
+        return (WEIGHT) atoll(env);
+    }
+    double avg_degree = n_nodes ? (double) n_edges / n_nodes : 1;
+    WEIGHT delta = (WEIGHT) (max_weight / (avg_degree > 1 ? avg_degree : 1));
+    return delta > 0 ? delta : 1;
+}
+
+Graph *pack_graph_if_asked(Graph *g) {
+    if (!packing_from_env()) {
+        return g;
     }
-    return sqrt((double) err);
+    unsigned long before = graph_bytes(g);
+    Graph *packed = graph_pack(g);
+    graph_free(g);
+    unsigned long after = graph_bytes(packed);
+    printf("Packed graph: %.1f MB -> %.1f MB (%.2fx smaller)\n", before / 1e6, after / 1e6, (double) before / after);
+    return packed;
 }
 
 void debug_init() {
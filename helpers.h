@@ -16,7 +16,32 @@
 
 static int DEBUG_MODE = 0;
 
-FlatMatrix *gen_graph(int n_nodes, unsigned long n_edges, int max_weight);
+Graph *gen_graph(int n_nodes, unsigned long n_edges, int max_weight);
+
+// generates only rows [row_lo, row_hi) of the graph gen_graph() would make,
+// as a block with global column ids. Nothing is cached on disk
+Graph *gen_graph_rows(int n_nodes, unsigned long n_edges, int max_weight, int row_lo, int row_hi);
+
+// the drivers take either [n_nodes] [n_edges] [max_weight] to generate a graph
+// or a single [graph_file] to map one. For a graph file, *graph_file is set and
+// the sizes come from its header, otherwise *graph_file is NULL.
+// Returns 0 on success, -1 on bad arguments
+int parse_graph_args(int argc, char **argv, char **graph_file, int *n_nodes, unsigned long *n_edges, int *max_weight);
+
+// maps graph_file if there is one, otherwise generates the graph
+Graph *load_graph(char *graph_file, int n_nodes, unsigned long n_edges, int max_weight);
+
+// whether GRAPH_STORAGE=packed asks for the packed graph backend (see graph_pack)
+int packing_from_env();
+
+// the bucket width for delta-stepping: the DELTA environment variable if set,
+// otherwise max_weight / average degree, about one light edge per vertex,
+// the usual choice for random weights
+WEIGHT pick_delta(WEIGHT max_weight, int n_nodes, unsigned long n_edges);
+
+// swaps g for its packed copy when packing_from_env() says so, printing what
+// it saved. Otherwise returns g as is
+Graph *pack_graph_if_asked(Graph *g);
 
 // function for pretty printing a square 2-d array
 void print_array(WEIGHT **arr, int dim);
@@ -0,0 +1,21 @@
+#ifndef __INTVEC_H__
+#define __INTVEC_H__
+
+#include <stdlib.h>
+
+// growable int array, for worklists and buckets. Zero initialize to start empty
+typedef struct {
+    int *items;
+    long len;
+    long capacity;
+} IntVec;
+
+static inline void vec_push(IntVec *v, int x) {
+    if (v->len == v->capacity) {
+        v->capacity = v->capacity ? 2 * v->capacity : 64;
+        v->items = realloc(v->items, v->capacity * sizeof(int));
+    }
+    v->items[v->len++] = x;
+}
+
+#endif
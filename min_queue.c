@@ -1,96 +1,241 @@
+#include <string.h>
+
 #include "min_queue.h"
+#include "bucket_queue.h"
+
+static const char *KIND_NAMES[] = {"heap", "radix", "dial"};
+
+MQUEUE_KIND mqueue_kind_from_env() {
+    char *name = getenv("QUEUE");
+    if (name == NULL) {
+        return MQUEUE_HEAP;
+    }
+    for (int k = 0; k < (int) (sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0])); k++) {
+        if (strcmp(name, KIND_NAMES[k]) == 0) {
+            return k;
+        }
+    }
+    printf("WARNING: unknown QUEUE %s, using heap\n", name);
+    return MQUEUE_HEAP;
+}
 
-//helper function to swap two nodes in an array
-static void swap(MinQueue *mq, int idx1, int idx2) {
-    MQNode *n1 = mq->arr[idx1];
-    mq->arr[idx1] = mq->arr[idx2];
-    mq->arr[idx2] = n1;
-    mq->arr[idx1]->idx = idx1;
-    mq->arr[idx2]->idx = idx2;
+const char *mqueue_kind_name(MQUEUE_KIND kind) {
+    return KIND_NAMES[kind];
 }
 
-// helper function to propogate a node up
-static int up_dog(MinQueue *mq, int i) {
-    while (i > 1) {
-        if (mq->arr[i]->val > mq->arr[i / 2]->val) {
+// implicit d-ary heap rooted at heap[0]: the children of i are
+// MQUEUE_ARITY * i + 1 .. MQUEUE_ARITY * i + MQUEUE_ARITY.
+// Both sifts carry the moving entry in hand and shift the others into the
+// hole, so each level costs one copy instead of a swap. They're shared by the
+// MinQueue heap and EntryHeap; pos[key] is kept up to date unless it's NULL
+
+// helper function to propogate an entry up from slot i
+static void up_dog(MQEntry *heap, int *pos, int i, MQEntry entry) {
+    while (i > 0) {
+        int parent = (i - 1) / MQUEUE_ARITY;
+        if (heap[parent].val <= entry.val) {
             break;
         }
-        // then we swap
-        swap(mq, i, i/2);
-        i /= 2;
+        heap[i] = heap[parent];
+        if (pos) {
+            pos[heap[i].key] = i;
+        }
+        i = parent;
+    }
+    heap[i] = entry;
+    if (pos) {
+        pos[entry.key] = i;
     }
-    return i;
 }
 
-// helper function to propogate a node up
-static int downward_dog(MinQueue *mq, int i) {
-    while (2*i <= mq->n_items) {
-        // if there is no right child
-        if (2*i == mq->n_items) {
-            // smaller than left child, then break
-            if (mq->arr[i]->val <= mq->arr[2*i]->val) {
-                break;
+// helper function to propogate an entry down from slot i of a heap of n_items
+static void downward_dog(MQEntry *heap, int *pos, int n_items, int i, MQEntry entry) {
+    while (1) {
+        int first = MQUEUE_ARITY * i + 1;
+        if (first >= n_items) {
+            break;
+        }
+        int last = first + MQUEUE_ARITY;
+        if (last > n_items) {
+            last = n_items;
+        }
+        int child = first;
+        for (int c = first + 1; c < last; c++) {
+            if (heap[c].val < heap[child].val) {
+                child = c;
             }
-
-            swap(mq, i, 2*i);
-            i = 2*i;
-            continue;
         }
-
-        // otherwise we choose the smaller child
-        int child_idx = 2*i;
-        if (mq->arr[2*i]->val > mq->arr[2*i + 1]->val) {
-            child_idx = 2*i + 1;
+        // done once we're no bigger than the smallest child
+        if (entry.val <= heap[child].val) {
+            break;
         }
-
-        // now we swap with child_idx
-        swap(mq, i, child_idx);
-        i = child_idx;
+        heap[i] = heap[child];
+        if (pos) {
+            pos[heap[i].key] = i;
+        }
+        i = child;
+    }
+    heap[i] = entry;
+    if (pos) {
+        pos[entry.key] = i;
     }
-    return i;
 }
 
 MinQueue *mqueue_init(int capacity) {
+    return mqueue_init_kind(MQUEUE_HEAP, capacity, 0);
+}
+
+MinQueue *mqueue_init_kind(MQUEUE_KIND kind, int capacity, WEIGHT max_weight) {
     MinQueue *mq = malloc(sizeof(MinQueue));
+    mq->kind = kind;
     mq->capacity = capacity;
-    mq->arr = malloc(capacity * sizeof(MQNode));
     mq->n_items = 0;
+    // keys are usually 0 .. capacity - 1, the key arrays grow if they aren't
+    mq->key_range = capacity ? capacity : 1;
+    mq->heap = NULL;
+    mq->pos = NULL;
+    if (kind != MQUEUE_HEAP) {
+        bucket_init(mq, max_weight);
+        return mq;
+    }
+    mq->heap = malloc((capacity ? capacity : 1) * sizeof(MQEntry));
+    mq->pos = malloc(mq->key_range * sizeof(int));
+    for (int k = 0; k < mq->key_range; k++) {
+        mq->pos[k] = -1;
+    }
     return mq;
 }
 
-int mqueue_insert(MinQueue *mq, MQNode *mqn) {
-    if (mq->n_items == mq->capacity) {
-       return -1;
+void mqueue_clear(MinQueue *mq) {
+    if (mq->kind != MQUEUE_HEAP) {
+        bucket_clear(mq);
+        return;
+    }
+    for (int i = 0; i < mq->n_items; i++) {
+        mq->pos[mq->heap[i].key] = -1;
+    }
+    mq->n_items = 0;
+}
+
+static void grow_keys(MinQueue *mq, int key) {
+    int range = mq->key_range;
+    while (range <= key) {
+        range *= 2;
+    }
+    mq->pos = realloc(mq->pos, range * sizeof(int));
+    for (int k = mq->key_range; k < range; k++) {
+        mq->pos[k] = -1;
+    }
+    mq->key_range = range;
+}
+
+int mqueue_contains(MinQueue *mq, int key) {
+    if (mq->kind != MQUEUE_HEAP) {
+        return bucket_contains(mq, key);
+    }
+    return key >= 0 && key < mq->key_range && mq->pos[key] != -1;
+}
+
+int mqueue_push(MinQueue *mq, int key, WEIGHT val) {
+    if (mq->kind != MQUEUE_HEAP) {
+        return bucket_push(mq, key, val);
+    }
+    if (mq->n_items == mq->capacity || key < 0 || mqueue_contains(mq, key)) {
+        return -1;
+    }
+    if (key >= mq->key_range) {
+        grow_keys(mq, key);
+    }
+    MQEntry entry = {val, key};
+    up_dog(mq->heap, mq->pos, mq->n_items++, entry);
+    return 0;
+}
+
+int mqueue_pop(MinQueue *mq, int *key, WEIGHT *val) {
+    if (mq->kind != MQUEUE_HEAP) {
+        return bucket_pop(mq, key, val);
+    }
+    if (mq->n_items == 0) {
+        return 0;
+    }
+    MQEntry min = mq->heap[0];
+    mq->pos[min.key] = -1;
+    // the last entry fills the root's hole
+    if (--mq->n_items > 0) {
+        downward_dog(mq->heap, mq->pos, mq->n_items, 0, mq->heap[mq->n_items]);
     }
+    if (key != NULL) {
+        *key = min.key;
+    }
+    if (val != NULL) {
+        *val = min.val;
+    }
+    return 1;
+}
 
-    // otherwise, we insert into the end and bubble up
-    // since the root node should be at index 1, increment n_items before assigning
-    mq->arr[++mq->n_items] = mqn;
-    mq->arr[mq->n_items]->idx = mq->n_items;
-    up_dog(mq, mq->n_items);
+void mqueue_update_key(MinQueue *mq, int key, WEIGHT new_val) {
+    if (mq->kind != MQUEUE_HEAP) {
+        bucket_update(mq, key, new_val);
+        return;
+    }
+    int i = mq->pos[key];
+    MQEntry entry = mq->heap[i];
+    WEIGHT old_val = entry.val;
+    entry.val = new_val;
+    // increasing priority means moving down in the heap
+    if (new_val > old_val) {
+        downward_dog(mq->heap, mq->pos, mq->n_items, i, entry);
+    } else {
+        up_dog(mq->heap, mq->pos, i, entry);
+    }
+}
 
+int mqueue_remove(MinQueue *mq, int key) {
+    if (!mqueue_contains(mq, key)) {
+        return -1;
+    }
+    if (mq->kind != MQUEUE_HEAP) {
+        bucket_remove(mq, key);
+        return 0;
+    }
+    int i = mq->pos[key];
+    mq->pos[key] = -1;
+    // the last entry fills the hole, and can belong above or below it
+    if (i != --mq->n_items) {
+        MQEntry entry = mq->heap[mq->n_items];
+        if (i > 0 && entry.val < mq->heap[(i - 1) / MQUEUE_ARITY].val) {
+            up_dog(mq->heap, mq->pos, i, entry);
+        } else {
+            downward_dog(mq->heap, mq->pos, mq->n_items, i, entry);
+        }
+    }
     return 0;
 }
 
+int mqueue_insert(MinQueue *mq, MQNode *mqn) {
+    return mqueue_push(mq, mqn->key, mqn->val);
+}
+
 MQNode *mqueue_peek_min(MinQueue *mq) {
     if (mqueue_is_empty(mq)) {
         return NULL;
     }
-    MQNode *min = mq->arr[1];
-    return min;
+    if (mq->kind != MQUEUE_HEAP) {
+        bucket_peek(mq, &mq->top.key, &mq->top.val);
+    } else {
+        mq->top.key = mq->heap[0].key;
+        mq->top.val = mq->heap[0].val;
+    }
+    mq->top.idx = 0;
+    return &mq->top;
 }
 
 MQNode *mqueue_pop_min(MinQueue *mq) {
-    if (mqueue_is_empty(mq)) {
+    if (!mqueue_pop(mq, &mq->top.key, &mq->top.val)) {
         return NULL;
     }
-    MQNode *min = mq->arr[1];
-    mq->arr[1] = mq->arr[mq->n_items];
-    mq->arr[1]->idx = 1;
-    mq->arr[mq->n_items] = NULL;
-    mq->n_items--;
-    downward_dog(mq, 1);
-    return min;
+    mq->top.idx = -1;
+    return &mq->top;
 }
 
 int mqueue_is_empty(MinQueue *mq) {
@@ -98,32 +243,66 @@ int mqueue_is_empty(MinQueue *mq) {
 }
 
 void mqueue_update_val(MinQueue *mq, MQNode *mqn, WEIGHT new_val) {
-    int i = mqn->idx;
-    WEIGHT old_val = mqn->val;
     mqn->val = new_val;
-    // increasing priority means moving down in the heap
-    if (new_val > old_val) {
-        downward_dog(mq, i);
-    } else if (new_val < old_val) {
-        up_dog(mq, i);
-    }
+    mqueue_update_key(mq, mqn->key, new_val);
 }
 
-void mqueue_free(MinQueue *mq, int dynamic_nodes) {
-    if (dynamic_nodes) {
-        for (int i = 0; i < mq->n_items; i++) {
-            free(mq->arr[i]);
-        }
+void mqueue_free(MinQueue *mq) {
+    if (mq->kind != MQUEUE_HEAP) {
+        bucket_free(mq);
     }
-    free(mq->arr);
+    free(mq->heap);
+    free(mq->pos);
     free(mq);
 }
 
 void mqueue_print(MinQueue *mq) {
-    for (int i = 1; i <= mq->n_items; i++) {
-        MQNode *mqn = mq->arr[i];
-        printf("(%d %d), ", mqn->key, mqn->val);
+    if (mq->kind != MQUEUE_HEAP) {
+        for (int b = 0; b < mq->n_buckets; b++) {
+            for (int k = mq->heads[b]; k != -1; k = mq->links[k].next) {
+                printf("(%d %" WEIGHT_FMT "), ", k, mq->links[k].val);
+            }
+        }
+        printf("\n");
+        return;
+    }
+    for (int i = 0; i < mq->n_items; i++) {
+        printf("(%d %" WEIGHT_FMT "), ", mq->heap[i].key, mq->heap[i].val);
     }
     printf("\n");
 }
 
+EntryHeap *eheap_init(int capacity) {
+    EntryHeap *h = malloc(sizeof(EntryHeap));
+    h->capacity = capacity ? capacity : 16;
+    h->n_items = 0;
+    h->heap = malloc(h->capacity * sizeof(MQEntry));
+    return h;
+}
+
+// the MinQueue heap's sifts with no pos, a key can be in here more than once
+void eheap_push(EntryHeap *h, int key, WEIGHT val) {
+    if (h->n_items == h->capacity) {
+        h->capacity *= 2;
+        h->heap = realloc(h->heap, h->capacity * sizeof(MQEntry));
+    }
+    MQEntry entry = {val, key};
+    up_dog(h->heap, NULL, h->n_items++, entry);
+}
+
+int eheap_pop(EntryHeap *h, int *key, WEIGHT *val) {
+    if (h->n_items == 0) {
+        return 0;
+    }
+    *key = h->heap[0].key;
+    *val = h->heap[0].val;
+    if (--h->n_items > 0) {
+        downward_dog(h->heap, NULL, h->n_items, 0, h->heap[h->n_items]);
+    }
+    return 1;
+}
+
+void eheap_free(EntryHeap *h) {
+    free(h->heap);
+    free(h);
+}
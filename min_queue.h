@@ -4,21 +4,102 @@
 #include <stdlib.h>
 #include "helpers.h"
 
+// children per heap node. 4 keeps a node's children in one cache line and
+// halves the depth of a binary heap; build with -DMQUEUE_ARITY=2 (or 8) to compare
+#ifndef MQUEUE_ARITY
+#define MQUEUE_ARITY 4
+#endif
+
+// heap: the d-ary heap below, any priorities, any order of operations.
+// radix and dial are monotone integer queues for Dijkstra: priorities must
+// be >= 0, and nothing pushed or updated may be below the last popped value.
+// radix: buckets by the highest bit that differs from the last pop,
+//  O(log C) amortized per vertex.
+// dial: one bucket per distance mod (max_weight + 1), scanned in a circle,
+//  O(C) per pop at worst.
+typedef enum {
+    MQUEUE_HEAP,
+    MQUEUE_RADIX,
+    MQUEUE_DIAL,
+} MQUEUE_KIND;
+
+// picks the kind from the QUEUE environment variable (heap, radix or dial).
+// Defaults to heap
+MQUEUE_KIND mqueue_kind_from_env();
+const char *mqueue_kind_name(MQUEUE_KIND kind);
+
 typedef struct {
     int key;
     WEIGHT val;
     int idx;
 } MQNode;
 
-// this will be a key-value store.
+// what the heap actually stores, inline
+typedef struct {
+    WEIGHT val;
+    int key;
+} MQEntry;
+
+// a key's slot in a radix/dial bucket list, kept together so a relink
+// touches one cache line
+typedef struct {
+    WEIGHT val;
+    int next;
+    int prev;
+    int bucket; // -1 when the key isn't in the queue
+} MQLink;
+
+// this will be a key-value store. Keys are small non-negative ints (vertex
+// ids) and each can be in the queue once; pos[key] is where it sits in
+// heap[], or -1. Nothing is allocated per item, so a queue can be cleared and
+// reused for the next query.
 typedef struct {
+    MQUEUE_KIND kind;
     int capacity;
     int n_items;
-    MQNode **arr;
+    MQEntry *heap;
+    int *pos;
+    int key_range;
+    MQNode top; // what peek_min/pop_min hand back
+
+    // radix and dial keep a doubly linked list per bucket, threaded through
+    // links[] indexed by key (see bucket_queue.c)
+    WEIGHT last;
+    int n_buckets;
+    int cursor;
+    int *heads;
+    MQLink *links;
 } MinQueue;
 
+// a heap
 MinQueue *mqueue_init(int capacity);
 
+// any kind. max_weight is the largest edge weight, only dial needs it
+MinQueue *mqueue_init_kind(MQUEUE_KIND kind, int capacity, WEIGHT max_weight);
+
+// empties the queue in O(n_items), keeping its memory
+void mqueue_clear(MinQueue *mq);
+
+// returns 0 on success, -1 if the queue is full or key is already in it
+int mqueue_push(MinQueue *mq, int key, WEIGHT val);
+
+// returns 0 if the queue is empty, otherwise pops the min into *key and *val
+// (either can be NULL)
+int mqueue_pop(MinQueue *mq, int *key, WEIGHT *val);
+
+// changes the priority of a key that is in the queue
+void mqueue_update_key(MinQueue *mq, int key, WEIGHT new_val);
+
+// takes a key out of the queue wherever it sits. Returns 0 if it was in
+// the queue, -1 if it wasn't
+int mqueue_remove(MinQueue *mq, int key);
+
+int mqueue_contains(MinQueue *mq, int key);
+
+// the node versions below copy the node's key and val in and out, they don't
+// keep the pointer. The node returned by pop_min/peek_min is only good until
+// the next call on the queue
+
 // returns 0 on success, -1 on fail
 int mqueue_insert(MinQueue *mq, MQNode *mqn);
 
@@ -29,8 +110,27 @@ int mqueue_is_empty(MinQueue *mq);
 
 void mqueue_update_val(MinQueue *mq, MQNode *mqn, WEIGHT new_val);
 
-void mqueue_free(MinQueue *mq, int dynamic_nodes);
+// the queue never holds the callers' nodes, so those are theirs to free
+void mqueue_free(MinQueue *mq);
 
 void mqueue_print(MinQueue *mq);
 
+// plain array-backed heap of (val, key) entries with no position index, so a
+// key can be in it any number of times. For lazy deletion, where stale
+// entries are skipped when they come out instead of being updated in place.
+// Grows as needed
+typedef struct {
+    int capacity;
+    int n_items;
+    MQEntry *heap;
+} EntryHeap;
+
+EntryHeap *eheap_init(int capacity);
+void eheap_push(EntryHeap *h, int key, WEIGHT val);
+
+// returns 0 if the heap is empty, otherwise pops the min into *key and *val
+int eheap_pop(EntryHeap *h, int *key, WEIGHT *val);
+
+void eheap_free(EntryHeap *h);
+
 #endif
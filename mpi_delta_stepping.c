@@ -0,0 +1,345 @@
+// distributed delta-stepping over MPI.
+//
+// Same buckets as delta_stepping.c, but every rank only keeps the buckets of
+// its own vertices. A phase relaxes the light in edges of the local part of
+// the current bucket. The sources of those edges can live anywhere, so the
+// relaxations that land on other ranks are collected as (target, via,
+// distance) requests and shipped in one all-to-all at the end of the phase.
+// One allreduce then gives the lowest non-empty bucket over all ranks: the
+// same bucket again means another light phase, a later one means the bucket
+// is settled, so its heavy edges go out in one more exchange and we move on.
+// That's a handful of collectives per phase and about (longest path / delta)
+// buckets in total, instead of one allgather per vertex in parallel_dijkstra.
+//
+// Within a rank the OpenMP threads split the rows being relaxed, each writing
+// its requests (ours included) to its own OfferList, and what comes back from
+// the exchange is applied through an OfferTable (see offers.h). MPI is only
+// called between the parallel loops, from the master thread.
+#include <stdio.h>
+#include <limits.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "helpers.h"
+#include "benchmarks.h"
+#include "resultr.h"
+#include "graph_mpi.h"
+#include "intvec.h"
+#include "offers.h"
+
+// the local engine state. in holds the in edges of our vertices, read
+// through edge iterators so it can be packed
+typedef struct {
+    Graph *in;
+    Partition *part;
+    WEIGHT delta;
+    WEIGHT *distances;
+    OfferTable *table;      // all changes to distances go through it
+    IntVec *bins;   // bins[b] holds our vertices queued for bucket b
+    long n_bins;
+    long lowest;    // no bin below this has anything in it
+    int n_threads;
+    OfferList *lists;       // each thread's requests...
+    OfferList out;          // ...and all of a phase's. n1 is the target's
+                            // local row on its owner, n2 the (global) vertex
+                            // the path goes through, weight the distance
+} DeltaState;
+
+int mpi_delta_stepping(Graph *in, Partition *part, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops);
+
+static void pprintf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    printf("[RANK %d]: ", rank);
+    vprintf(fmt, args);
+}
+
+int main(int argc, char **argv) {
+
+    double start_wall, end_wall, cpu;
+
+    mpi_init_threads(&argc, &argv);
+
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: mpi_delta_stepping [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
+        exit(1);
+    }
+
+    debug_init();
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    WEIGHT *global_distances = NULL;
+    int *global_next_hops = NULL;
+    if (rank == 0) {
+        global_distances = calloc(n_nodes, sizeof(WEIGHT));
+        global_next_hops = calloc(n_nodes, sizeof(int));
+    }
+
+    Partition *part;
+    Graph *per_node_graph = graph_load_partitioned(graph_file, n_nodes, n_edges, max_weight, &part, MPI_COMM_WORLD);
+    if (per_node_graph == NULL) {
+        exit(1);
+    }
+    // relaxing a vertex walks its in edges, so those are all we keep
+    Graph *in_graph = graph_in_edges(per_node_graph, part, MPI_COMM_WORLD);
+    graph_free(per_node_graph);
+    in_graph = graph_pack_if_asked(in_graph, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    timing(&start_wall, &cpu);
+
+    WEIGHT *local_distances = calloc(part->n_local ? part->n_local : 1, sizeof(WEIGHT));
+    int *local_next_hops = calloc(part->n_local ? part->n_local : 1, sizeof(int));
+
+    mpi_delta_stepping(in_graph, part, n_nodes, n_edges, 0, local_distances, local_next_hops);
+
+    partition_gather(part, local_distances, global_distances, MPI_WEIGHT, 0, MPI_COMM_WORLD);
+    partition_gather(part, local_next_hops, global_next_hops, MPI_INT, 0, MPI_COMM_WORLD);
+    timing(&end_wall, &cpu);
+    pprintf("Delta stepping's time: %.4f\n", end_wall - start_wall);
+
+    if (rank == 0) {
+        if (store_result_soft(SEED, n_nodes, n_edges, max_weight, ALGO_MPI_DELTA_STEPPING, global_distances, global_next_hops) == -1) {
+            printf("Could not store result!\n");
+        }
+
+        // for comparison, get results from serial dijsktra
+        WEIGHT *ser_distances = calloc(n_nodes, sizeof(WEIGHT));
+        int *ser_next_hops = calloc(n_nodes, sizeof(int));
+        if (read_result(SEED, n_nodes, n_edges, max_weight, ALGO_SER_DIJKSTRA, ser_distances, ser_next_hops) == -1) {
+            pprintf("Could not read past result!\n");
+        } else {
+            printf("L2 norm with serial dijkstra: %lf\n", l2_norm(global_distances, ser_distances, n_nodes));
+        }
+        free(ser_distances);
+        free(ser_next_hops);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    ///  CLEAN UP
+    ///////////////////////////////////////////////////////////////////////////
+    free(local_distances);
+    free(local_next_hops);
+    if (rank == 0) {
+        free(global_distances);
+        free(global_next_hops);
+    }
+    graph_free(in_graph);
+    partition_free(part);
+
+    MPI_Finalize();
+
+    return 0;
+}
+
+static void bins_push(DeltaState *s, long b, int r) {
+    if (b >= s->n_bins) {
+        long n_bins = s->n_bins ? s->n_bins : 16;
+        while (n_bins <= b) {
+            n_bins *= 2;
+        }
+        s->bins = realloc(s->bins, n_bins * sizeof(IntVec));
+        memset(s->bins + s->n_bins, 0, (n_bins - s->n_bins) * sizeof(IntVec));
+        s->n_bins = n_bins;
+    }
+    vec_push(&s->bins[b], r);
+    if (b < s->lowest) {
+        s->lowest = b;
+    }
+}
+
+// our lowest non-empty bucket, LONG_MAX if there is none
+static long lowest_bucket(DeltaState *s) {
+    while (s->lowest < s->n_bins && s->bins[s->lowest].len == 0) {
+        s->lowest++;
+    }
+    return s->lowest < s->n_bins ? s->lowest : LONG_MAX;
+}
+
+// applies requests for our rows, the ones that get better go in their bucket
+static void apply(DeltaState *s, Edge *requests, unsigned long n) {
+    offers_apply(s->table, requests, n);
+    for (long k = 0; k < s->table->n_improved; k++) {
+        int r = s->table->improved[k];
+        bins_push(s, s->distances[r] / s->delta, r);
+    }
+}
+
+// writes down the requests from the light (heavy == 0) or heavy (heavy == 1)
+// in edges of local row r. The edges are split on the fly, w <= delta is light
+static void relax(DeltaState *s, int r, int heavy, OfferList *list) {
+    int u = s->part->local_nodes[r];
+    WEIGHT d = s->distances[r];
+    EdgeIter it;
+    graph_out_iter(s->in, r, &it);
+    int n;
+    WEIGHT w;
+    while (edge_iter_next(&it, &n, &w)) {
+        if ((w > s->delta) != heavy) {
+            continue;
+        }
+        WEIGHT alt_dist = weight_add(d, w);
+        // saturated means unreachable through u, nothing to offer
+        if (alt_dist != WEIGHT_MAX) {
+            offer_list_push(list, s->part->local_idx[n], u, alt_dist, s->part->owner[n]);
+        }
+    }
+}
+
+// relaxes the light (or heavy) edges of rows[0..n) with every thread
+static void relax_rows(DeltaState *s, int *rows, long n, int heavy) {
+    #pragma omp parallel
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        #pragma omp for schedule(dynamic, 64)
+        for (long i = 0; i < n; i++) {
+            relax(s, rows[i], heavy, &s->lists[tid]);
+        }
+    }
+    offer_list_merge(&s->out, s->lists, s->n_threads);
+}
+
+// ships the phase's requests, ours included, and applies what we got.
+// Returns how many went to other ranks. Collective
+static unsigned long exchange(DeltaState *s, int rank) {
+    unsigned long n_recv;
+    Edge *recv = graph_exchange_edges(s->out.edges, s->out.dests, s->out.len, &n_recv, MPI_COMM_WORLD);
+    apply(s, recv, n_recv);
+    free(recv);
+    unsigned long sent = 0;
+    for (unsigned long i = 0; i < s->out.len; i++) {
+        sent += s->out.dests[i] != rank;
+    }
+    s->out.len = 0;
+    return sent;
+}
+
+// global lowest non-empty bucket. Collective
+static long next_bucket(DeltaState *s) {
+    long mine = lowest_bucket(s);
+    long next;
+    MPI_Allreduce(&mine, &next, 1, MPI_LONG, MPI_MIN, MPI_COMM_WORLD);
+    return next;
+}
+
+int mpi_delta_stepping(Graph *in, Partition *part, int n_nodes, unsigned long n_edges, int dest, WEIGHT *distances, int *next_hops) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int n_local = part->n_local;
+
+    DeltaState s;
+    memset(&s, 0, sizeof(s));
+    s.in = in;
+    s.part = part;
+    // every rank has to land on the same delta, so the max weight is global
+    WEIGHT local_max = graph_max_weight(in);
+    WEIGHT max_weight;
+    MPI_Allreduce(&local_max, &max_weight, 1, MPI_WEIGHT, MPI_MAX, MPI_COMM_WORLD);
+    s.delta = pick_delta(max_weight, n_nodes, n_edges);
+    s.distances = distances;
+    s.lowest = LONG_MAX;
+    s.n_threads = 1;
+#ifdef _OPENMP
+    s.n_threads = omp_get_max_threads();
+#endif
+    s.lists = calloc(s.n_threads, sizeof(OfferList));
+    if (rank == 0) {
+        printf("Delta stepping with delta %" WEIGHT_FMT "\n", s.delta);
+    }
+
+    // heavy_bucket[r] is the last bucket whose heavy edges r has gone out for
+    long *heavy_bucket = malloc((n_local ? n_local : 1) * sizeof(long));
+    for (int r = 0; r < n_local; r++) {
+        distances[r] = WEIGHT_MAX;
+        next_hops[r] = -1;
+        heavy_bucket[r] = -1;
+    }
+    s.table = offers_init(n_local, distances, next_hops);
+    if (part->owner[dest] == rank) {
+        Edge init = {part->local_idx[dest], -1, 0};
+        apply(&s, &init, 1);
+    }
+
+    IntVec frontier = {NULL, 0, 0};
+    IntVec settled = {NULL, 0, 0};
+    long phases = 0;
+    long buckets = 0;
+    unsigned long requests = 0;
+    long bucket = next_bucket(&s);
+    while (bucket != LONG_MAX) {
+        // light phases until nobody has anything left in this bucket
+        while (1) {
+            // take the bucket out, relaxing can refill it
+            frontier.len = 0;
+            if (bucket < s.n_bins) {
+                IntVec swap = s.bins[bucket];
+                s.bins[bucket] = frontier;
+                frontier = swap;
+            }
+            long live = 0;
+            for (long i = 0; i < frontier.len; i++) {
+                int r = frontier.items[i];
+                // r got a better distance after going in here and went out
+                // with that lower bucket already
+                if (distances[r] / s.delta != bucket) {
+                    continue;
+                }
+                if (heavy_bucket[r] != bucket) {
+                    heavy_bucket[r] = bucket;
+                    vec_push(&settled, r);
+                }
+                frontier.items[live++] = r;
+            }
+            relax_rows(&s, frontier.items, live, 0);
+            requests += exchange(&s, rank);
+            phases++;
+            if (next_bucket(&s) != bucket) {
+                break;
+            }
+        }
+
+        // no rank has light work left in this bucket, so what went through
+        // it is final and its heavy edges can go out
+        relax_rows(&s, settled.items, settled.len, 1);
+        settled.len = 0;
+        requests += exchange(&s, rank);
+        buckets++;
+        bucket = next_bucket(&s);
+    }
+
+    unsigned long total_requests;
+    MPI_Reduce(&requests, &total_requests, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        printf("Delta stepping took %ld phases over %ld buckets, %lu requests between ranks\n",
+                phases, buckets, total_requests);
+    }
+
+    for (long b = 0; b < s.n_bins; b++) {
+        free(s.bins[b].items);
+    }
+    free(s.bins);
+    free(frontier.items);
+    free(settled.items);
+    for (int tid = 0; tid < s.n_threads; tid++) {
+        offer_list_free(&s.lists[tid]);
+    }
+    free(s.lists);
+    offer_list_free(&s.out);
+    offers_free(s.table);
+    free(heavy_bucket);
+    return 0;
+}
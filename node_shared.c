@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "node_shared.h"
+
+int node_shared_from_env() {
+    char *shared = getenv("NODE_SHARED");
+    return shared == NULL || strcmp(shared, "0") != 0;
+}
+
+NodeComm *node_comm_init(MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    NodeComm *nc = malloc(sizeof(NodeComm));
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nc->node);
+    MPI_Comm_rank(nc->node, &nc->node_rank);
+    MPI_Comm_size(nc->node, &nc->node_size);
+    MPI_Comm_split(comm, nc->node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &nc->leaders);
+    return nc;
+}
+
+void node_comm_free(NodeComm *nc) {
+    if (nc->leaders != MPI_COMM_NULL) {
+        MPI_Comm_free(&nc->leaders);
+    }
+    MPI_Comm_free(&nc->node);
+    free(nc);
+}
+
+void *node_shared_alloc(NodeComm *nc, unsigned long bytes, MPI_Win *win) {
+    // only the leader's part has any memory, the rest just map it
+    MPI_Aint size = nc->node_rank == 0 ? (MPI_Aint) (bytes ? bytes : 1) : 0;
+    void *base;
+    MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, nc->node, &base, win);
+    MPI_Aint leader_size;
+    int disp_unit;
+    MPI_Win_shared_query(*win, 0, &leader_size, &disp_unit, &base);
+    return base;
+}
+
+void *node_shared_allreduce(NodeComm *nc, void *local, int count, MPI_Datatype type, MPI_Op op, MPI_Win *win) {
+    int size;
+    MPI_Type_size(type, &size);
+    void *shared = node_shared_alloc(nc, (unsigned long) count * size, win);
+    MPI_Win_fence(0, *win);
+    MPI_Reduce(local, nc->node_rank == 0 ? shared : NULL, count, type, op, 0, nc->node);
+    if (nc->leaders != MPI_COMM_NULL) {
+        MPI_Allreduce(MPI_IN_PLACE, shared, count, type, op, nc->leaders);
+    }
+    MPI_Win_fence(0, *win);
+    return shared;
+}
@@ -0,0 +1,34 @@
+#ifndef __NODE_SHARED_H__
+#define __NODE_SHARED_H__
+
+#include <mpi.h>
+
+// some arrays come out the same on every rank, like the partition maps or
+// the lightest edge into each vertex, and they're O(n) each. Ranks on the
+// same node can map one copy of them through an MPI-3 shared window instead
+// of keeping one apiece, which divides that memory by the ranks per node
+typedef struct {
+    MPI_Comm node;          // the ranks on our node
+    MPI_Comm leaders;       // node rank 0 of every node, MPI_COMM_NULL on the rest
+    int node_rank;
+    int node_size;
+} NodeComm;
+
+// whether NODE_SHARED asks for node shared arrays. On unless it is 0
+int node_shared_from_env();
+
+// splits comm by node. Collective
+NodeComm *node_comm_init(MPI_Comm comm);
+void node_comm_free(NodeComm *nc);
+
+// bytes in a window shared by the node. Every rank gets node rank 0's copy;
+// writes to it show up on the other ranks after an MPI_Win_fence. Collective
+// over the node
+void *node_shared_alloc(NodeComm *nc, unsigned long bytes, MPI_Win *win);
+
+// MPI_Allreduce of every rank's local into a node shared array: reduced onto
+// node rank 0 first, then between the node leaders only. Returns the result,
+// which the caller frees with MPI_Win_free(win). Collective over the whole comm
+void *node_shared_allreduce(NodeComm *nc, void *local, int count, MPI_Datatype type, MPI_Op op, MPI_Win *win);
+
+#endif
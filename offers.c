@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "offers.h"
+
+// batches smaller than this aren't worth waking the threads for
+#define PARALLEL_MIN_OFFERS 1024
+
+static void reserve(OfferList *l, unsigned long capacity) {
+    if (capacity <= l->capacity) {
+        return;
+    }
+    unsigned long c = l->capacity ? l->capacity : 1024;
+    while (c < capacity) {
+        c *= 2;
+    }
+    l->edges = realloc(l->edges, c * sizeof(Edge));
+    l->dests = realloc(l->dests, c * sizeof(int));
+    l->capacity = c;
+}
+
+void offer_list_push(OfferList *l, int row, int via, WEIGHT d, int dest) {
+    reserve(l, l->len + 1);
+    Edge offer = {row, via, d};
+    l->edges[l->len] = offer;
+    l->dests[l->len++] = dest;
+}
+
+void offer_list_merge(OfferList *dst, OfferList *lists, int n) {
+    unsigned long *at = malloc((n ? n : 1) * sizeof(unsigned long));
+    unsigned long len = dst->len;
+    for (int i = 0; i < n; i++) {
+        at[i] = len;
+        len += lists[i].len;
+    }
+    reserve(dst, len);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < n; i++) {
+        memcpy(dst->edges + at[i], lists[i].edges, lists[i].len * sizeof(Edge));
+        memcpy(dst->dests + at[i], lists[i].dests, lists[i].len * sizeof(int));
+        lists[i].len = 0;
+    }
+    dst->len = len;
+    free(at);
+}
+
+void offer_list_free(OfferList *l) {
+    free(l->edges);
+    free(l->dests);
+    l->edges = NULL;
+    l->dests = NULL;
+    l->len = l->capacity = 0;
+}
+
+OfferTable *offers_init(int n_rows, WEIGHT *distances, int *next_hops) {
+    OfferTable *t = malloc(sizeof(OfferTable));
+    t->n_rows = n_rows;
+    t->distances = distances;
+    t->next_hops = next_hops;
+    t->best = malloc((n_rows ? n_rows : 1) * sizeof(WEIGHT));
+    memcpy(t->best, distances, n_rows * sizeof(WEIGHT));
+    t->claimed = calloc(n_rows ? n_rows : 1, 1);
+    t->improved = malloc((n_rows ? n_rows : 1) * sizeof(int));
+    t->n_improved = 0;
+    return t;
+}
+
+long offers_apply(OfferTable *t, Edge *offers, unsigned long n) {
+    WEIGHT *best = t->best;
+    WEIGHT *distances = t->distances;
+    char *claimed = t->claimed;
+    t->n_improved = 0;
+
+    #pragma omp parallel if (n >= PARALLEL_MIN_OFFERS)
+    {
+        #pragma omp for schedule(static)
+        for (unsigned long i = 0; i < n; i++) {
+            atomic_min_weight(&best[offers[i].n1], offers[i].weight);
+        }
+        // best is settled now and distances aren't written until the
+        // claims are all in, so plain reads of both are fine here
+        #pragma omp for schedule(static)
+        for (unsigned long i = 0; i < n; i++) {
+            int r = offers[i].n1;
+            if (offers[i].weight == best[r] && best[r] < distances[r]
+                    && !__atomic_exchange_n(&claimed[r], 1, __ATOMIC_RELAXED)) {
+                t->next_hops[r] = offers[i].n2;
+                t->improved[__atomic_fetch_add(&t->n_improved, 1, __ATOMIC_RELAXED)] = r;
+            }
+        }
+        #pragma omp for schedule(static)
+        for (long k = 0; k < t->n_improved; k++) {
+            int r = t->improved[k];
+            distances[r] = best[r];
+            claimed[r] = 0;
+        }
+    }
+    return t->n_improved;
+}
+
+void offers_free(OfferTable *t) {
+    free(t->best);
+    free(t->claimed);
+    free(t->improved);
+    free(t);
+}
@@ -0,0 +1,50 @@
+#ifndef __OFFERS_H__
+#define __OFFERS_H__
+
+#include "graph.h"
+
+// the distributed engines relax with OpenMP threads by having every thread
+// write down what it would do instead of doing it, then applying the lot.
+// An offer is an Edge: row n1 can get distance weight through global node
+// n2. The rank it is for goes in dests, so a list can be handed straight to
+// graph_exchange_edges
+typedef struct {
+    Edge *edges;
+    int *dests;
+    unsigned long len;
+    unsigned long capacity;
+} OfferList;
+
+void offer_list_push(OfferList *l, int row, int via, WEIGHT d, int dest);
+
+// appends lists[0..n) (one per thread, usually) to dst and empties them
+void offer_list_merge(OfferList *dst, OfferList *lists, int n);
+
+// frees what l holds, not l
+void offer_list_free(OfferList *l);
+
+// applies batches of offers to a rank's rows with any number of threads and
+// no locks: a first pass takes the min of the offers for each row with an
+// atomic min into a copy of the distances, a second lets one of the offers
+// that made it claim the row and set its hop, and a third commits the claimed
+// rows. best == distances between batches, so the distances can only change
+// through offers_apply once the table is made
+typedef struct {
+    int n_rows;
+    WEIGHT *distances;
+    int *next_hops;
+    WEIGHT *best;
+    char *claimed;
+    int *improved;          // the rows the last batch made better, each once
+    long n_improved;
+} OfferTable;
+
+OfferTable *offers_init(int n_rows, WEIGHT *distances, int *next_hops);
+
+// applies offers[0..n) and returns how many rows got better (t->n_improved).
+// Of several offers tying for a row's new distance, any one may set the hop
+long offers_apply(OfferTable *t, Edge *offers, unsigned long n);
+
+void offers_free(OfferTable *t);
+
+#endif
@@ -0,0 +1,173 @@
+// shared memory Bellman-Ford with OpenMP, in two flavors picked by BF_MODE.
+//
+// pull (the default): every round the rows are split over the threads and
+// each vertex takes the min over its own out edges, through the same
+// (SIMD) kernel as serial_bellman_ford. A vertex is only ever written by the
+// thread that owns its row, so nothing needs an atomic min; the kernel just
+// loads and stores distances with relaxed atomics. Other threads may see an
+// older or newer distance for a vertex mid round, which can only make the
+// round converge faster.
+//
+// push: only the vertices that changed last round do anything. Each one
+// relaxes its in edges and lowers the sources with an atomic min, marking
+// the ones it lowered for the next round. This does far less work per round
+// once the active set is small, at the price of the atomics.
+//
+// Either way the rounds stop once a whole round changes nothing, and a round
+// n_nodes that still changes something means a negative cycle.
+#include <stdio.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "helpers.h"
+#include "benchmarks.h"
+#include "bf_kernel.h"
+#include "resultr.h"
+
+// rows per chunk handed to a thread in pull mode
+#define PULL_CHUNK 1024
+
+int omp_bellman_ford(Graph *graph, int n_nodes, int dest, int push, WEIGHT *distances, int *next_hops);
+
+int main(int argc, char **argv) {
+
+    double start_wall, end_wall, cpu;
+
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: omp_bf [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
+        exit(1);
+    }
+
+    debug_init();
+
+    Graph *graph = load_graph(graph_file, n_nodes, n_edges, max_weight);
+    if (graph == NULL) {
+        exit(1);
+    }
+
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    char *mode = getenv("BF_MODE");
+    int push = mode != NULL && strcmp(mode, "push") == 0;
+    if (mode != NULL && !push && strcmp(mode, "pull") != 0) {
+        printf("WARNING: unknown BF_MODE %s, using pull\n", mode);
+    }
+    printf("OpenMP BF (%s, %s kernel) with %d threads\n", push ? "push" : "pull",
+            bf_kernel_name(bf_kernel_pick()), n_threads);
+
+    WEIGHT *distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *next_hops = calloc(n_nodes, sizeof(int));
+
+    timing(&start_wall, &cpu);
+    int rounds = omp_bellman_ford(graph, n_nodes, 0, push, distances, next_hops);
+    timing(&end_wall, &cpu);
+    printf("OpenMP BF's time: %.4f (%d rounds)\n", end_wall - start_wall, rounds);
+    if (rounds == -1) {
+        printf("OpenMP BF found a negative cycle!\n");
+    }
+
+    store_result_soft(SEED, n_nodes, n_edges, max_weight, ALGO_OMP_BF, distances, next_hops);
+
+    // for comparison, get results from serial dijsktra
+    WEIGHT *ser_distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *ser_next_hops = calloc(n_nodes, sizeof(int));
+    if (read_result(SEED, n_nodes, n_edges, max_weight, ALGO_SER_DIJKSTRA, ser_distances, ser_next_hops) == -1) {
+        printf("Could not read past result!\n");
+    } else {
+        printf("L2 norm with serial dijkstra: %lf\n", l2_norm(distances, ser_distances, n_nodes));
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    ///  CLEAN UP
+    ///////////////////////////////////////////////////////////////////////////
+    free(ser_distances);
+    free(ser_next_hops);
+    free(distances);
+    free(next_hops);
+    graph_free(graph);
+
+    return 0;
+}
+
+static int pull_rounds(Graph *graph, int n_nodes, WEIGHT *distances, int *next_hops) {
+    BF_KERNEL kernel = bf_kernel_pick();
+    int rounds = 0;
+    int changed = 1;
+    while (changed && rounds < n_nodes) {
+        rounds++;
+        changed = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(|:changed)
+        for (int lo = 0; lo < n_nodes; lo += PULL_CHUNK) {
+            int hi = lo + PULL_CHUNK < n_nodes ? lo + PULL_CHUNK : n_nodes;
+            changed |= bf_relax_rows(kernel, graph, lo, hi, distances, next_hops);
+        }
+    }
+    return changed ? -1 : rounds;
+}
+
+static int push_rounds(Graph *graph, int n_nodes, int dest, WEIGHT *distances, int *next_hops) {
+    graph_build_reverse(graph);
+
+    // active[v]: v changed last round, next_active collects this round's
+    char *active = calloc(n_nodes ? n_nodes : 1, 1);
+    char *next_active = calloc(n_nodes ? n_nodes : 1, 1);
+    active[dest] = 1;
+
+    int rounds = 0;
+    int changed = 1;
+    while (changed && rounds < n_nodes) {
+        rounds++;
+        changed = 0;
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(|:changed)
+        for (int v = 0; v < n_nodes; v++) {
+            if (!active[v]) {
+                continue;
+            }
+            active[v] = 0;
+            WEIGHT d = __atomic_load_n(&distances[v], __ATOMIC_RELAXED);
+            EdgeIter it;
+            graph_in_iter(graph, v, &it);
+            int n;
+            WEIGHT w;
+            while (edge_iter_next(&it, &n, &w)) {
+                WEIGHT alt_dist = weight_add(d, w);
+                if (alt_dist != WEIGHT_MAX && atomic_min_weight(&distances[n], alt_dist)) {
+                    __atomic_store_n(&next_active[n], 1, __ATOMIC_RELAXED);
+                    changed = 1;
+                }
+            }
+        }
+        char *swap = active;
+        active = next_active;
+        next_active = swap;
+    }
+
+    recompute_next_hops(graph, n_nodes, dest, distances, next_hops);
+
+    free(active);
+    free(next_active);
+    return changed ? -1 : rounds;
+}
+
+int omp_bellman_ford(Graph *graph, int n_nodes, int dest, int push, WEIGHT *distances, int *next_hops) {
+    #pragma omp parallel for
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = WEIGHT_MAX;
+        next_hops[v] = -1;
+    }
+    distances[dest] = 0;
+
+    if (push) {
+        return push_rounds(graph, n_nodes, dest, distances, next_hops);
+    }
+    return pull_rounds(graph, n_nodes, distances, next_hops);
+}
@@ -1,10 +1,20 @@
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "helpers.h"
 #include "benchmarks.h"
 #include "resultr.h"
+#include "graph_mpi.h"
+#include "offers.h"
+#include "node_shared.h"
+
+// the smallest per proc block of settled nodes a round sends
+#define MIN_SETTLE_BLOCK 64
 
 enum MPI_TAG {
     TAG_KEY,
@@ -20,83 +30,57 @@ static void pprintf(const char *fmt, ...) {
     vprintf(fmt, args);
 }
 
-MQNode DUMMY = {-1, -1, -1};
-
-int parallel_dijkstra(FlatMatrix *adj_matrix, int n_nodes, int n_edges, int src, WEIGHT *distances, int *next_hops);
+int parallel_dijkstra(Graph *graph, Partition *part, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *next_hops);
 
 int main(int argc, char **argv) {
 
     double start_wall, end_wall, cpu;
 
-    MPI_Init(&argc, &argv);
+    mpi_init_threads(&argc, &argv);
 
-    // arguments we need are the number of nodes and number of edges
-    if (argc != 4) {
-        printf("Usage: serial [n_nodes] [n_edges] [max_weight]\n");
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: serial [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
         exit(1);
     }
 
 
     debug_init();
 
-    int n_nodes = atoi(argv[1]);
-    unsigned long n_edges = atoi(argv[2]);
-    int max_weight = atoi(argv[3]);
-
-    FlatMatrix *adj_matrix;
     int rank, n_procs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
 
-    // master proc should split the graph up and distribute to each node
+    // no proc holds the whole graph, each one loads just its own rows
     // also each proc should have their own version of distances[] and next_hops[]
 
-    // now we get our cluster.
-    // ASSUME that num_procs | n_nodes
-    int nodes_per_proc = n_nodes / n_procs;
-    // each node will have a matrix with nodes_per_proc rows and n_nodes cols
-    FlatMatrix *per_node_matrix = flat_matrix_init(n_nodes, nodes_per_proc);
     // global distances and global next_hops for gathering
     WEIGHT *global_distances = NULL;
     int *global_next_hops = NULL;
 
-    // the master proc will generate the graph
+    // master proc only needs room to gather the results
     if (rank == 0) {
         // allocate global distances and next_hops
         global_distances = calloc(n_nodes, sizeof(WEIGHT));
         global_next_hops = calloc(n_nodes, sizeof(int));
+    }
 
-
-        adj_matrix = gen_graph(n_nodes, n_edges, max_weight);
-        if (adj_matrix == NULL) {
-            exit(1);
-        }
-
-        //flat_matrix_print(adj_matrix);
-        /*for (int i = 0; i < n_nodes * n_nodes; i++) {*/
-            /*printf("%d ", adj_matrix->arr[i]);*/
-        /*}*/
+    // since the graph is stored by rows, each proc ends up with just the out
+    // edges of its own cluster: a graph with part->n_local rows and n_nodes cols
+    Partition *part;
+    Graph *per_node_graph = graph_load_partitioned(graph_file, n_nodes, n_edges, max_weight, &part, MPI_COMM_WORLD);
+    if (per_node_graph == NULL) {
+        exit(1);
     }
+    // the engine only reads the block through edge iterators, so pack it if asked
+    per_node_graph = graph_pack_if_asked(per_node_graph, MPI_COMM_WORLD);
     MPI_Barrier(MPI_COMM_WORLD);
     timing(&start_wall, &cpu);
 
-    int send_per_proc = nodes_per_proc * n_nodes;
-    int *send_buf = (rank == 0) ? adj_matrix->arr : &send_per_proc;
-    // we want to scatter. Since we store the matrix in row-major form, we can just
-    // take chunks of the adjacency matrix
-    int scatter_res = MPI_Scatter(
-            send_buf,
-            send_per_proc,
-            MPI_INT,
-            per_node_matrix->arr,
-            send_per_proc,
-            MPI_INT,
-            0,
-            MPI_COMM_WORLD);
-    if (scatter_res) {
-        pprintf("Error when scattering!\n");
-    }
-
     // function signatures should look like
     // int shortest_path(adj_matrix, n_nodes, source, WEIGHT *distances, int **paths)
     // distances and paths will be the outputs
@@ -108,12 +92,13 @@ int main(int argc, char **argv) {
     //print_array(adj_matrix, n_nodes);
 
     // each node has its own next_hops and distances arrays
-    int *dijkstra_next_hops = calloc(nodes_per_proc, sizeof(int));
+    int *dijkstra_next_hops = calloc(part->n_local ? part->n_local : 1, sizeof(int));
 
-    WEIGHT *dijkstra_distances = calloc(nodes_per_proc, sizeof(WEIGHT));
+    WEIGHT *dijkstra_distances = calloc(part->n_local ? part->n_local : 1, sizeof(WEIGHT));
 
 
-    parallel_dijkstra(per_node_matrix,
+    parallel_dijkstra(per_node_graph,
+                    part,
                     n_nodes,
                     n_edges,
                     0,
@@ -121,9 +106,9 @@ int main(int argc, char **argv) {
                     dijkstra_next_hops);
 
 
-    // now we gather the results
-    MPI_Gather(dijkstra_distances, nodes_per_proc, MPI_INT, global_distances, nodes_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Gather(dijkstra_next_hops, nodes_per_proc, MPI_INT, global_next_hops, nodes_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
+    // now we gather the results back into global order
+    partition_gather(part, dijkstra_distances, global_distances, MPI_WEIGHT, 0, MPI_COMM_WORLD);
+    partition_gather(part, dijkstra_next_hops, global_next_hops, MPI_INT, 0, MPI_COMM_WORLD);
     timing(&end_wall, &cpu);
     pprintf("Dijkstra's time: %.4f\n", end_wall - start_wall);
     // for comparison, get results from serial dijsktra
@@ -170,137 +155,262 @@ int main(int argc, char **argv) {
     free(dijkstra_distances);
     /*free(serial_distances);*/
     if (rank == 0) {
-        flat_matrix_free(adj_matrix);
         free(global_distances);
         free(global_next_hops);
     }
-    flat_matrix_free(per_node_matrix);
+    graph_free(per_node_graph);
+    partition_free(part);
 
     MPI_Finalize();
 
     return 0;
 }
 
-int parallel_dijkstra(FlatMatrix *adj_matrix, int n_nodes, int n_edges, int src, WEIGHT *distances, int *next_hops) {
+int parallel_dijkstra(Graph *graph, Partition *part, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *next_hops) {
 
-    //pprintf("PER_NODE MATRIX!!!!!\n");
-    //flat_matrix_print(adj_matrix);
     // same thing as serial, except...
-    // 1. Each processor gets assigned a "cluster" of nodes and maintains their own min heap
-    //      WE WILL ASSUME THAT THE NUMBER OF PROCESSORS DIVIDES THE NUMBER OF NODES
-    // 2. When we want our global min, each node reports their local min
-    //      and we aggregate to get our global min
-    // 3. We advertise the global min, and each processor updates their own nodes to check if they
-    //      need updating
-    // 4. Repeat until they are all empty
+    // 1. Each processor gets assigned a "cluster" of nodes and maintains their own min heaps
+    // 2. One allreduce gives the global min distance L and the global min of
+    //      distance + lightest edge into the vertex, T
+    // 3. Every queued node that is provably final by now gets settled, not
+    //      just the min (Crauser et al.):
+    //      OUT: d(v) <= T. Nothing still queued can reach v with less than T
+    //      IN:  d(v) - (lightest edge out of v) <= L. Any better path has to
+    //          come through a queued vertex, so it costs at least L plus one edge
+    //      The global min always passes IN, so every round settles something.
+    // 4. The settled nodes are allgathered and each processor relaxes its own
+    //      nodes against them. So a round is one allreduce and one allgather
+    // 5. Repeat until they are all empty
     //
-    // For clarity, I will have one master node coordinating the action (as well as doing some calculations)
+    // The OpenMP threads split the settled nodes in step 4 and write down the
+    // improvements they find instead of making them. An OfferTable (see
+    // offers.h) applies those, and only the rows that got better go through
+    // the (serial) queues.
     //
+    // Paths run towards src, so "out" here means along the relaxation: the
+    // edges into v in the graph, and "in" the graph's edges out of v
     int rank, n_procs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
 
-    // now we get our cluster.
-    // ASSUME that num_procs | n_nodes
-    int nodes_per_proc = n_nodes / n_procs;
-    int offset = nodes_per_proc * rank;
+    // our cluster: row v of the graph is global node part->local_nodes[v]
+    int n_local = part->n_local;
 
+    // for each (global) node, the block's reverse index has the local nodes that
+    // have an edge into it. This is what we walk for every settled node
+    graph_build_reverse(graph);
 
-    // buffers for the keys/vals for the min select
-    WEIGHT *gather_vals = calloc(n_procs, sizeof(WEIGHT));
-    WEIGHT *gather_keys = calloc(n_procs, sizeof(int));
+    // lightest edge out of each of our nodes, and into each node. The edges
+    // into a node are spread over everyone's blocks, so that one is reduced
+    WEIGHT *min_edge_out = malloc((n_local ? n_local : 1) * sizeof(WEIGHT));
+    WEIGHT *min_edge_in = malloc(n_nodes * sizeof(WEIGHT));
+    #pragma omp parallel for
+    for (int c = 0; c < n_nodes; c++) {
+        min_edge_in[c] = WEIGHT_MAX;
+    }
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < n_local; v++) {
+        min_edge_out[v] = WEIGHT_MAX;
+        EdgeIter it;
+        graph_out_iter(graph, v, &it);
+        int c;
+        WEIGHT w;
+        while (edge_iter_next(&it, &c, &w)) {
+            if (w < min_edge_out[v]) {
+                min_edge_out[v] = w;
+            }
+            atomic_min_weight(&min_edge_in[c], w);
+        }
+    }
+    MPI_Win min_edge_win = MPI_WIN_NULL;
+    if (node_shared_from_env()) {
+        // the reduced array is the same on every rank, so one copy per node
+        NodeComm *nc = node_comm_init(MPI_COMM_WORLD);
+        WEIGHT *shared = node_shared_allreduce(nc, min_edge_in, n_nodes, MPI_WEIGHT, MPI_MIN, &min_edge_win);
+        node_comm_free(nc);
+        free(min_edge_in);
+        min_edge_in = shared;
+    } else {
+        MPI_Allreduce(MPI_IN_PLACE, min_edge_in, n_nodes, MPI_WEIGHT, MPI_MIN, MPI_COMM_WORLD);
+    }
 
-    MQNode **mqns = malloc(nodes_per_proc * sizeof(MQNode)); // oh boy
-    MinQueue *mq = mqueue_init(nodes_per_proc);
+    // keys are local rows. mq is by distance, out_q by distance + lightest edge
+    // in and in_q by distance - lightest edge out. A node is in all three or none
+    MinQueue *mq = mqueue_init(n_local);
+    MinQueue *out_q = mqueue_init(n_local);
+    MinQueue *in_q = mqueue_init(n_local);
 
-    // Everything stored in the min queue is in global terms
-    // initialize all of the distances into the min queue
-    for (int v = 0; v < nodes_per_proc; v++) {
-        // each node keeps track of its own min queue
-        if (v + offset == src) {
-            distances[src - offset] = 0;
-        } else {
-            distances[v] = INT_MAX;
-        }
+    for (int v = 0; v < n_local; v++) {
+        distances[v] = WEIGHT_MAX;
         next_hops[v] = -1;
-        MQNode *mqn = malloc(sizeof(MQNode));
-        mqns[v] = mqn;
-        mqn->key = v + offset;
-        mqn->val = distances[v];
-        mqueue_insert(mq, mqn);
     }
-
+    if (part->owner[src] == rank) {
+        int v = part->local_idx[src];
+        distances[v] = 0;
+        mqueue_push(mq, v, 0);
+        mqueue_push(out_q, v, min_edge_in[src]);
+        mqueue_push(in_q, v, -min_edge_out[v]);
+    }
+    OfferTable *table = offers_init(n_local, distances, next_hops);
+
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    // each thread's offers, then all of a round's
+    OfferList *lists = calloc(n_threads, sizeof(OfferList));
+    OfferList offers = {NULL, NULL, 0, 0};
+
+    // the settled nodes of a round go out in one allgather of fixed size
+    // blocks, one per proc: block[0].key is how many of the block[1..] are
+    // used, the rest are (distance, global id). A proc settles at most
+    // block_cap nodes a round and leaves the rest queued for the next one,
+    // which is fine since they stay final. Everyone sees every count, so
+    // everyone agrees on the next round's block_cap without another collective
+    MPI_Datatype entry_type;
+    MPI_Type_contiguous(sizeof(MQEntry), MPI_BYTE, &entry_type);
+    MPI_Type_commit(&entry_type);
+    int block_cap = MIN_SETTLE_BLOCK;
+    MQEntry *mine = malloc((block_cap + 1) * sizeof(MQEntry));
+    MQEntry *all = malloc((long) n_procs * (block_cap + 1) * sizeof(MQEntry));
+    MQEntry *settled = malloc((long) n_procs * block_cap * sizeof(MQEntry));
+
+    long rounds = 0;
     while (1) {
-        // now we get the global min. Each one checks its local min
-        MQNode *local_min = mqueue_peek_min(mq);
-        // if the node is empty, we will send -1, -1
-        if (local_min == NULL) {
-            local_min = &DUMMY;
+        WEIGHT bounds[2] = {WEIGHT_MAX, WEIGHT_MAX};
+        MQNode *top = mqueue_peek_min(mq);
+        if (top != NULL) {
+            bounds[0] = top->val;
         }
-
-
-        //pprintf("LOCAL MIN: %d %d\n", local_min->key, local_min->val);
-        // now we do allgather. Once for the keys and once for the vals
-        MPI_Allgather(&local_min->key, 1, MPI_INT, gather_keys, 1, MPI_INT, MPI_COMM_WORLD);
-        MPI_Allgather(&local_min->val, 1, MPI_INT, gather_vals, 1, MPI_INT, MPI_COMM_WORLD);
-
-        // now we get the local min. To ensure consistency, we pick the min from the latest
-        // process if there are ties.
-        int min_proc = 0;
-        WEIGHT min_val = gather_vals[0];
-        for (int i = 1; i < n_procs; i++) {
-            if ((gather_vals[i] != -1 && gather_vals[i] <= min_val)
-                    || min_val == -1) {
-                min_proc= i;
-                min_val = gather_vals[i];
-                //pprintf("SETTING min_proc %d min_val %zd", min_proc, min_val);
-            }
+        top = mqueue_peek_min(out_q);
+        if (top != NULL) {
+            bounds[1] = top->val;
         }
-        int min_node = gather_keys[min_proc];
+        MPI_Allreduce(MPI_IN_PLACE, bounds, 2, MPI_WEIGHT, MPI_MIN, MPI_COMM_WORLD);
+        WEIGHT l = bounds[0];
+        WEIGHT t = bounds[1];
 
         // check if we have nothing left
-        if (min_val == -1) {
+        if (l == WEIGHT_MAX) {
             break;
         }
-
-        //pprintf("CHOSEN MIN: key, val (%zd, %d) from proc %d\n", min_node, min_val, min_proc);
-        if (min_proc == rank) {
-            mqueue_pop_min(mq);
-            distances[min_node - offset] = min_val;
+        rounds++;
+
+        // the global min comes first out of its proc's mq, so even a full
+        // block settles it
+        int n_mine = 0;
+        int v;
+        while (n_mine < block_cap && (top = mqueue_peek_min(mq)) != NULL && top->val <= t) {
+            mqueue_pop(mq, &v, NULL);
+            mqueue_remove(out_q, v);
+            mqueue_remove(in_q, v);
+            MQEntry e = {distances[v], part->local_nodes[v]};
+            mine[1 + n_mine++] = e;
+        }
+        while (n_mine < block_cap && (top = mqueue_peek_min(in_q)) != NULL && top->val <= l) {
+            mqueue_pop(in_q, &v, NULL);
+            mqueue_remove(mq, v);
+            mqueue_remove(out_q, v);
+            MQEntry e = {distances[v], part->local_nodes[v]};
+            mine[1 + n_mine++] = e;
+        }
+        mine[0].key = n_mine;
+
+        MPI_Allgather(mine, block_cap + 1, entry_type, all, block_cap + 1, entry_type, MPI_COMM_WORLD);
+        int n_all = 0;
+        int max_count = 0;
+        for (int p = 0; p < n_procs; p++) {
+            MQEntry *block = all + (long) p * (block_cap + 1);
+            memcpy(settled + n_all, block + 1, block[0].key * sizeof(MQEntry));
+            n_all += block[0].key;
+            if (block[0].key > max_count) {
+                max_count = block[0].key;
+            }
         }
 
-        // now each proc updates their own mqueue based on the min val that was chosen
-        for (int i = 0; i < nodes_per_proc; i++) {
-            // pprintf("i, min_node %d, %d\n", i, min_node);
-            if (!flat_matrix_get(adj_matrix, i, min_node)) {
-                //pprintf("Zero found at (%d, %zd)\n", i, min_node);
-                continue;
+        // now each proc relaxes their own nodes against the ones that were settled
+        #pragma omp parallel
+        {
+            int tid = 0;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+#endif
+            #pragma omp for schedule(dynamic, 16)
+            for (int s = 0; s < n_all; s++) {
+                int min_node = settled[s].key;
+                WEIGHT min_val = settled[s].val;
+                EdgeIter it;
+                graph_in_iter(graph, min_node, &it);
+                int i;
+                WEIGHT w;
+                while (edge_iter_next(&it, &i, &w)) {
+                    WEIGHT alt_dist = weight_add(min_val, w);
+                    if (alt_dist < distances[i]) {
+                        // the hop will be globally indexed
+                        offer_list_push(&lists[tid], i, min_node, alt_dist, rank);
+                    }
+                }
             }
-            int alt_dist = min_val + flat_matrix_get(adj_matrix, i, min_node);
-            // debugf("For node %d, alt_dist %ld, distances %d, adj_matrix %d\n", n, alt_dist, distances[n], flat_matrix_get(adj_matrix, n, v));
-            if (min_val != INT_MAX && alt_dist < distances[i]) {
-                distances[i] = (WEIGHT) alt_dist;
-                next_hops[i] = min_node; // this will be globally indexed
-                /*pprintf("Updating node %d distance to %d\n", i + offset, alt_dist);*/
-                mqueue_update_val(mq, mqns[i], alt_dist);
+        }
+        offer_list_merge(&offers, lists, n_threads);
+        offers_apply(table, offers.edges, offers.len);
+        offers.len = 0;
+
+        // and updates their queues for the ones that got better
+        for (long k = 0; k < table->n_improved; k++) {
+            int i = table->improved[k];
+            WEIGHT alt_dist = distances[i];
+            WEIGHT out_val = weight_add(alt_dist, min_edge_in[part->local_nodes[i]]);
+            WEIGHT in_val = alt_dist - min_edge_out[i];
+            if (mqueue_contains(mq, i)) {
+                mqueue_update_key(mq, i, alt_dist);
+                mqueue_update_key(out_q, i, out_val);
+                mqueue_update_key(in_q, i, in_val);
+            } else {
+                mqueue_push(mq, i, alt_dist);
+                mqueue_push(out_q, i, out_val);
+                mqueue_push(in_q, i, in_val);
             }
         }
 
+        // room for twice the biggest block this round, so a proc that filled
+        // its block gets a bigger one next time
+        int cap = MIN_SETTLE_BLOCK;
+        while (cap < 2 * max_count) {
+            cap *= 2;
+        }
+        if (cap != block_cap) {
+            block_cap = cap;
+            mine = realloc(mine, (block_cap + 1) * sizeof(MQEntry));
+            all = realloc(all, (long) n_procs * (block_cap + 1) * sizeof(MQEntry));
+            settled = realloc(settled, (long) n_procs * block_cap * sizeof(MQEntry));
+        }
+    }
+    if (rank == 0) {
+        printf("Dijkstra took %ld rounds\n", rounds);
     }
-
-    /*for (int i = 0; i < nodes_per_proc; i++) {*/
-        /*pprintf("NOde %zd distance: %d\n", i + offset, distances[i]);*/
-    /*}*/
 
     //////////////////////////////////////////////////////////////
     // CLEANUP
     //////////////////////////////////////////////////////////////
-    free(gather_keys);
-    free(gather_vals);
-    mqueue_free(mq, 0);
-    for (int i = 0; i < nodes_per_proc; i++) {
-        free(mqns[i]);
+    for (int tid = 0; tid < n_threads; tid++) {
+        offer_list_free(&lists[tid]);
     }
-    free(mqns);
-
+    free(lists);
+    offer_list_free(&offers);
+    offers_free(table);
+    MPI_Type_free(&entry_type);
+    free(mine);
+    free(all);
+    free(settled);
+    free(min_edge_out);
+    if (min_edge_win != MPI_WIN_NULL) {
+        MPI_Win_free(&min_edge_win);
+    } else {
+        free(min_edge_in);
+    }
+    mqueue_free(mq);
+    mqueue_free(out_q);
+    mqueue_free(in_q);
+    return 0;
 }
@@ -0,0 +1,330 @@
+#include "helpers.h"
+#include "partition.h"
+#include "node_shared.h"
+#include "rng.h"
+
+// a rank can end up with this much more than its share of the edges
+#define PARTITION_IMBALANCE 1.05
+#define LABEL_PROP_ROUNDS 10
+
+// rng stream for deciding which label propagation moves go through
+#define STREAM_LP_MOVE 0x4c50
+
+static const char *KIND_NAMES[] = {"block", "edges", "lp"};
+
+PARTITION_KIND partition_kind_from_env() {
+    char *name = getenv("PARTITION");
+    if (name == NULL) {
+        return PARTITION_EDGES;
+    }
+    for (int k = 0; k < (int) (sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0])); k++) {
+        if (strcmp(name, KIND_NAMES[k]) == 0) {
+            return k;
+        }
+    }
+    printf("WARNING: unknown PARTITION %s, using edges\n", name);
+    return PARTITION_EDGES;
+}
+
+const char *partition_kind_name(PARTITION_KIND kind) {
+    return KIND_NAMES[kind];
+}
+
+// local_idx[v] = v's row on its owner
+static void number_vertices(int *owner, int n_nodes, int n_procs, int *local_idx) {
+    int *next = calloc(n_procs, sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        // walking v in order keeps every rank's vertices sorted
+        local_idx[v] = next[owner[v]]++;
+    }
+    free(next);
+}
+
+Partition *partition_from_owner(int *owner, int n_nodes, MPI_Comm comm) {
+    int rank, n_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &n_procs);
+
+    Partition *part = malloc(sizeof(Partition));
+    part->n_nodes = n_nodes;
+    part->n_procs = n_procs;
+    part->counts = calloc(n_procs, sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        part->counts[owner[v]]++;
+    }
+    part->maps_win = MPI_WIN_NULL;
+    if (node_shared_from_env()) {
+        // the node leader fills in the one copy, the others drop theirs
+        NodeComm *nc = node_comm_init(comm);
+        int *maps = node_shared_alloc(nc, 2 * (unsigned long) n_nodes * sizeof(int), &part->maps_win);
+        MPI_Win_fence(0, part->maps_win);
+        if (nc->node_rank == 0) {
+            memcpy(maps, owner, n_nodes * sizeof(int));
+            number_vertices(owner, n_nodes, n_procs, maps + n_nodes);
+        }
+        MPI_Win_fence(0, part->maps_win);
+        node_comm_free(nc);
+        free(owner);
+        part->owner = maps;
+        part->local_idx = maps + n_nodes;
+    } else {
+        part->owner = owner;
+        part->local_idx = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+        number_vertices(owner, n_nodes, n_procs, part->local_idx);
+    }
+    part->n_local = part->counts[rank];
+    part->local_nodes = malloc((part->n_local ? part->n_local : 1) * sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        if (part->owner[v] == rank) {
+            part->local_nodes[part->local_idx[v]] = v;
+        }
+    }
+    return part;
+}
+
+Partition *partition_block(int n_nodes, MPI_Comm comm) {
+    int n_procs;
+    MPI_Comm_size(comm, &n_procs);
+    // the first n_nodes % n_procs ranks get one extra
+    int *owner = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    int base = n_nodes / n_procs;
+    int extra = n_nodes % n_procs;
+    int v = 0;
+    for (int p = 0; p < n_procs; p++) {
+        int count = base + (p < extra);
+        for (int i = 0; i < count; i++) {
+            owner[v++] = p;
+        }
+    }
+    return partition_from_owner(owner, n_nodes, comm);
+}
+
+// out degree + 1 for every vertex, on every rank
+static unsigned long *vertex_weights(Graph *block, Partition *part, MPI_Comm comm) {
+    unsigned long *local = malloc((part->n_local ? part->n_local : 1) * sizeof(unsigned long));
+    for (int r = 0; r < part->n_local; r++) {
+        local[r] = graph_degree(block, r) + 1;
+    }
+    unsigned long *weights = malloc((part->n_nodes ? part->n_nodes : 1) * sizeof(unsigned long));
+    partition_allgather(part, local, weights, MPI_UNSIGNED_LONG, comm);
+    free(local);
+    return weights;
+}
+
+Partition *partition_edges(Graph *block, Partition *part, MPI_Comm comm) {
+    int n_procs = part->n_procs;
+    int n_nodes = part->n_nodes;
+    unsigned long *weights = vertex_weights(block, part, comm);
+    unsigned long total = 0;
+    for (int v = 0; v < n_nodes; v++) {
+        total += weights[v];
+    }
+
+    // a vertex goes to whichever rank's share of the total its first edge falls in
+    int *owner = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    unsigned long before = 0;
+    for (int v = 0; v < n_nodes; v++) {
+        owner[v] = (int) ((double) before * n_procs / total);
+        before += weights[v];
+    }
+    free(weights);
+    return partition_from_owner(owner, n_nodes, comm);
+}
+
+// adds the labels of the vertices in row r of g to the tally
+static void count_labels(Graph *g, int r, int *labels, int *tally, int *touched, int *n_touched) {
+    EdgeIter it;
+    graph_out_iter(g, r, &it);
+    int n;
+    WEIGHT w;
+    while (edge_iter_next(&it, &n, &w)) {
+        int l = labels[n];
+        if (tally[l]++ == 0) {
+            touched[(*n_touched)++] = l;
+        }
+    }
+}
+
+Partition *partition_label_prop(Graph *block, Graph *in_block, Partition *part, MPI_Comm comm) {
+    int n_procs = part->n_procs;
+    int n_nodes = part->n_nodes;
+    int n_local = part->n_local;
+
+    unsigned long *weights = vertex_weights(block, part, comm);
+    double *loads = calloc(n_procs, sizeof(double));
+    double total = 0;
+    for (int v = 0; v < n_nodes; v++) {
+        loads[part->owner[v]] += weights[v];
+        total += weights[v];
+    }
+    double cap = PARTITION_IMBALANCE * total / n_procs;
+
+    int *labels = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    memcpy(labels, part->owner, n_nodes * sizeof(int));
+    int *local_labels = malloc((n_local ? n_local : 1) * sizeof(int));
+    int *wanted = malloc((n_local ? n_local : 1) * sizeof(int));
+
+    int *tally = calloc(n_procs, sizeof(int));
+    int *touched = malloc(n_procs * sizeof(int));
+    double *requests = malloc(n_procs * sizeof(double));
+    double *all_requests = malloc(n_procs * sizeof(double));
+    double *accept = malloc(n_procs * sizeof(double));
+    double *delta = malloc(n_procs * sizeof(double));
+    double *all_delta = malloc(n_procs * sizeof(double));
+
+    for (int round = 0; round < LABEL_PROP_ROUNDS; round++) {
+        // every vertex picks the label most of its neighbors (either direction) have
+        memset(requests, 0, n_procs * sizeof(double));
+        for (int r = 0; r < n_local; r++) {
+            int v = part->local_nodes[r];
+            int n_touched = 0;
+            count_labels(block, r, labels, tally, touched, &n_touched);
+            count_labels(in_block, r, labels, tally, touched, &n_touched);
+
+            // only move for a strict improvement, ties go to the lower rank
+            int best = labels[v];
+            for (int i = 0; i < n_touched; i++) {
+                int l = touched[i];
+                if (tally[l] > tally[best] || (tally[l] == tally[best] && l < best && best != labels[v])) {
+                    best = l;
+                }
+            }
+            for (int i = 0; i < n_touched; i++) {
+                tally[touched[i]] = 0;
+            }
+            wanted[r] = best;
+            if (best != labels[v]) {
+                requests[best] += weights[v];
+            }
+        }
+
+        // everyone moving at once would overfill the popular ranks, so each
+        // rank lets in moves with the probability that keeps it under cap
+        MPI_Allreduce(requests, all_requests, n_procs, MPI_DOUBLE, MPI_SUM, comm);
+        for (int p = 0; p < n_procs; p++) {
+            double room = cap - loads[p];
+            accept[p] = all_requests[p] <= room ? 1 : (room > 0 ? room / all_requests[p] : 0);
+        }
+
+        long moves = 0;
+        memset(delta, 0, n_procs * sizeof(double));
+        for (int r = 0; r < n_local; r++) {
+            int v = part->local_nodes[r];
+            local_labels[r] = labels[v];
+            if (wanted[r] == labels[v]) {
+                continue;
+            }
+            unsigned long long key = ((unsigned long long) round << 32) | (unsigned int) v;
+            if (rng_unit(rng_at(SEED, STREAM_LP_MOVE, key)) < accept[wanted[r]]) {
+                delta[labels[v]] -= weights[v];
+                delta[wanted[r]] += weights[v];
+                local_labels[r] = wanted[r];
+                moves++;
+            }
+        }
+
+        long all_moves;
+        MPI_Allreduce(&moves, &all_moves, 1, MPI_LONG, MPI_SUM, comm);
+        MPI_Allreduce(delta, all_delta, n_procs, MPI_DOUBLE, MPI_SUM, comm);
+        for (int p = 0; p < n_procs; p++) {
+            loads[p] += all_delta[p];
+        }
+        partition_allgather(part, local_labels, labels, MPI_INT, comm);
+        debugf("label propagation round %d moved %ld vertices\n", round, all_moves);
+        if (all_moves == 0) {
+            break;
+        }
+    }
+
+    free(weights);
+    free(loads);
+    free(local_labels);
+    free(wanted);
+    free(tally);
+    free(touched);
+    free(requests);
+    free(all_requests);
+    free(accept);
+    free(delta);
+    free(all_delta);
+    return partition_from_owner(labels, n_nodes, comm);
+}
+
+unsigned long partition_edge_cut(Graph *block, Partition *rows, Partition *part, MPI_Comm comm) {
+    unsigned long cut = 0;
+    for (int r = 0; r < rows->n_local; r++) {
+        int owner = part->owner[rows->local_nodes[r]];
+        EdgeIter it;
+        graph_out_iter(block, r, &it);
+        int v;
+        WEIGHT w;
+        while (edge_iter_next(&it, &v, &w)) {
+            if (part->owner[v] != owner) {
+                cut++;
+            }
+        }
+    }
+    unsigned long total;
+    MPI_Allreduce(&cut, &total, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+    return total;
+}
+
+// rank by rank order -> global vertex order
+static void unshuffle(Partition *part, char *by_rank, char *global, int size) {
+    int *displs = malloc(part->n_procs * sizeof(int));
+    displs[0] = 0;
+    for (int p = 1; p < part->n_procs; p++) {
+        displs[p] = displs[p - 1] + part->counts[p - 1];
+    }
+    for (int v = 0; v < part->n_nodes; v++) {
+        long src = displs[part->owner[v]] + part->local_idx[v];
+        memcpy(global + (long) v * size, by_rank + src * size, size);
+    }
+    free(displs);
+}
+
+static void gather(Partition *part, void *local, void *global, MPI_Datatype type, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int size;
+    MPI_Type_size(type, &size);
+    int *displs = malloc(part->n_procs * sizeof(int));
+    displs[0] = 0;
+    for (int p = 1; p < part->n_procs; p++) {
+        displs[p] = displs[p - 1] + part->counts[p - 1];
+    }
+    char *by_rank = NULL;
+    if (root == -1 || rank == root) {
+        by_rank = malloc((part->n_nodes ? part->n_nodes : 1) * (long) size);
+    }
+    if (root == -1) {
+        MPI_Allgatherv(local, part->n_local, type, by_rank, part->counts, displs, type, comm);
+    } else {
+        MPI_Gatherv(local, part->n_local, type, by_rank, part->counts, displs, type, root, comm);
+    }
+    if (by_rank != NULL) {
+        unshuffle(part, by_rank, global, size);
+    }
+    free(by_rank);
+    free(displs);
+}
+
+void partition_gather(Partition *part, void *local, void *global, MPI_Datatype type, int root, MPI_Comm comm) {
+    gather(part, local, global, type, root, comm);
+}
+
+void partition_allgather(Partition *part, void *local, void *global, MPI_Datatype type, MPI_Comm comm) {
+    gather(part, local, global, type, -1, comm);
+}
+
+void partition_free(Partition *part) {
+    if (part->maps_win != MPI_WIN_NULL) {
+        MPI_Win_free(&part->maps_win);
+    } else {
+        free(part->owner);
+        free(part->local_idx);
+    }
+    free(part->counts);
+    free(part->local_nodes);
+    free(part);
+}
@@ -0,0 +1,64 @@
+#ifndef __PARTITION_H__
+#define __PARTITION_H__
+
+#include <mpi.h>
+
+#include "graph.h"
+
+// which rank holds which vertices. Every rank sees the whole map (O(n)), but
+// only has its own rows of the graph. A rank's vertices don't have to be
+// contiguous: row r of its block is vertex local_nodes[r]. The map is the
+// same everywhere, so unless NODE_SHARED=0 the ranks of a node share one
+// read only copy of it (see node_shared.h)
+typedef struct {
+    int n_nodes;
+    int n_procs;
+    int *owner;         // owner[v] is the rank holding vertex v
+    int *local_idx;     // v's row on its owner
+    MPI_Win maps_win;   // the window owner and local_idx are in, or MPI_WIN_NULL
+    int *counts;        // number of vertices on each rank
+    int n_local;        // this rank's vertices...
+    int *local_nodes;   // ...by global id, sorted
+} Partition;
+
+typedef enum {
+    PARTITION_BLOCK,        // n_nodes / n_procs consecutive vertices each (the old split)
+    PARTITION_EDGES,        // consecutive vertices, balanced by out edges
+    PARTITION_LABEL_PROP,   // label propagation from the edge balanced split, cuts fewer edges
+} PARTITION_KIND;
+
+// picks the partitioner from the PARTITION environment variable
+// (block, edges or lp). Defaults to edges
+PARTITION_KIND partition_kind_from_env();
+const char *partition_kind_name(PARTITION_KIND kind);
+
+// builds the rest of the partition from a full owner map, which has to be the
+// same on every rank. Takes ownership of owner. Collective
+Partition *partition_from_owner(int *owner, int n_nodes, MPI_Comm comm);
+
+// consecutive blocks as even as possible. Works for any n_procs
+Partition *partition_block(int n_nodes, MPI_Comm comm);
+
+// block holds the rows of part (in the usual local_nodes order). Collective.
+// Splits the vertices into consecutive runs with about the same number of
+// out edges (plus one per vertex, so empty rows still count for something)
+Partition *partition_edges(Graph *block, Partition *part, MPI_Comm comm);
+
+// block and in_block hold the out and in edges of part's vertices. Moves
+// vertices to the rank most of their neighbors are on for a few rounds,
+// starting from part, while keeping every rank's edge count within
+// PARTITION_IMBALANCE of the average. Deterministic under SEED. Collective
+Partition *partition_label_prop(Graph *block, Graph *in_block, Partition *part, MPI_Comm comm);
+
+// number of edges of block that cross ranks under part, summed over all ranks
+unsigned long partition_edge_cut(Graph *block, Partition *rows, Partition *part, MPI_Comm comm);
+
+// local holds one element per local vertex (in local_nodes order). Fills
+// global, indexed by global vertex id, on root (gather) or everywhere (allgather)
+void partition_gather(Partition *part, void *local, void *global, MPI_Datatype type, int root, MPI_Comm comm);
+void partition_allgather(Partition *part, void *local, void *global, MPI_Datatype type, MPI_Comm comm);
+
+// collective when the maps are node shared
+void partition_free(Partition *part);
+
+#endif
@@ -0,0 +1,57 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf_counter.h"
+
+void perf_counter_open(PerfCounter *pc, COUNTER_KIND kind) {
+    pc->fd = -1;
+    pc->value = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kind == COUNTER_CACHE_MISSES ? PERF_COUNT_HW_CACHE_MISSES : PERF_COUNT_HW_CACHE_REFERENCES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // this thread only, on whatever cpu it runs on
+    pc->fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+void perf_counter_start(PerfCounter *pc) {
+#ifdef __linux__
+    if (pc->fd != -1) {
+        ioctl(pc->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void perf_counter_stop(PerfCounter *pc) {
+    pc->value = -1;
+#ifdef __linux__
+    if (pc->fd != -1) {
+        ioctl(pc->fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        if (read(pc->fd, &count, sizeof(count)) == sizeof(count)) {
+            pc->value = count;
+        }
+    }
+#endif
+}
+
+void perf_counter_close(PerfCounter *pc) {
+    if (pc->fd != -1) {
+        close(pc->fd);
+        pc->fd = -1;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef __PERF_COUNTER_H__
+#define __PERF_COUNTER_H__
+
+// hardware counters through linux perf_event_open, for the benchmarks.
+// Counting needs perf_event_paranoid to allow it (or root); when it isn't
+// allowed, or we're not on linux, the counter just reads -1
+typedef enum {
+    COUNTER_CACHE_MISSES,
+    COUNTER_CACHE_REFERENCES,
+} COUNTER_KIND;
+
+typedef struct {
+    int fd;
+    long long value;
+} PerfCounter;
+
+void perf_counter_open(PerfCounter *pc, COUNTER_KIND kind);
+
+// start zeroes the count, stop leaves it in pc->value (-1 if unavailable)
+void perf_counter_start(PerfCounter *pc);
+void perf_counter_stop(PerfCounter *pc);
+
+void perf_counter_close(PerfCounter *pc);
+
+#endif
@@ -0,0 +1,218 @@
+#include <string.h>
+
+#include "helpers.h"
+#include "reorder.h"
+
+static const char *ORDERING_NAMES[] = {"none", "rcm", "bfs", "degree", "hub"};
+
+ORDERING ordering_from_env() {
+    char *name = getenv("ORDERING");
+    if (name == NULL) {
+        return ORDER_NONE;
+    }
+    for (int o = 0; o < N_ORDERINGS; o++) {
+        if (strcmp(name, ORDERING_NAMES[o]) == 0) {
+            return o;
+        }
+    }
+    printf("WARNING: unknown ORDERING %s, using none\n", name);
+    return ORDER_NONE;
+}
+
+const char *ordering_name(ORDERING ordering) {
+    return ORDERING_NAMES[ordering];
+}
+
+// in + out degree of every vertex
+static unsigned long *total_degrees(Graph *g) {
+    unsigned long *degrees = malloc((g->n_rows ? g->n_rows : 1) * sizeof(unsigned long));
+    for (int v = 0; v < g->n_rows; v++) {
+        degrees[v] = graph_degree(g, v) + graph_in_degree(g, v);
+    }
+    return degrees;
+}
+
+// vertices sorted by degree (stable), ascending or descending
+static int *by_degree(unsigned long *degrees, int n_nodes, int descending) {
+    unsigned long max_degree = 0;
+    for (int v = 0; v < n_nodes; v++) {
+        if (degrees[v] > max_degree) {
+            max_degree = degrees[v];
+        }
+    }
+    unsigned long *start = calloc(max_degree + 2, sizeof(unsigned long));
+    for (int v = 0; v < n_nodes; v++) {
+        unsigned long d = descending ? max_degree - degrees[v] : degrees[v];
+        start[d + 1]++;
+    }
+    for (unsigned long d = 0; d <= max_degree; d++) {
+        start[d + 1] += start[d];
+    }
+    int *order = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        unsigned long d = descending ? max_degree - degrees[v] : degrees[v];
+        order[start[d]++] = v;
+    }
+    free(start);
+    return order;
+}
+
+// qsort can't take a context, so the degrees for the rcm neighbor sort live here
+static unsigned long *sort_degrees;
+
+static int cmp_degree(const void *a, const void *b) {
+    int u = *(const int *) a;
+    int v = *(const int *) b;
+    if (sort_degrees[u] != sort_degrees[v]) {
+        return sort_degrees[u] < sort_degrees[v] ? -1 : 1;
+    }
+    return u - v;
+}
+
+// appends v's unvisited neighbors (both directions) to the queue
+static void visit_neighbors(Graph *g, int v, char *visited, int *queue, int *tail) {
+    for (int dir = 0; dir < 2; dir++) {
+        EdgeIter it;
+        if (dir == 0) {
+            graph_out_iter(g, v, &it);
+        } else {
+            graph_in_iter(g, v, &it);
+        }
+        int n;
+        WEIGHT w;
+        while (edge_iter_next(&it, &n, &w)) {
+            if (!visited[n]) {
+                visited[n] = 1;
+                queue[(*tail)++] = n;
+            }
+        }
+    }
+}
+
+// bfs over every component, starting them in the order given by starts.
+// With degrees set, each vertex's new neighbors are queued lowest degree
+// first (Cuthill-McKee)
+static int *bfs_order(Graph *g, int *starts, unsigned long *degrees) {
+    int n_nodes = g->n_rows;
+    char *visited = calloc(n_nodes ? n_nodes : 1, 1);
+    int *order = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    int head = 0, tail = 0;
+    sort_degrees = degrees;
+    for (int s = 0; s < n_nodes; s++) {
+        if (visited[starts[s]]) {
+            continue;
+        }
+        visited[starts[s]] = 1;
+        order[tail++] = starts[s];
+        while (head < tail) {
+            int first = tail;
+            visit_neighbors(g, order[head++], visited, order, &tail);
+            if (degrees != NULL) {
+                qsort(order + first, tail - first, sizeof(int), cmp_degree);
+            }
+        }
+    }
+    free(visited);
+    return order;
+}
+
+int *reorder_permutation(Graph *g, ORDERING ordering, int root) {
+    int n_nodes = g->n_rows;
+    graph_build_reverse(g);
+    unsigned long *degrees = total_degrees(g);
+
+    // order[i] is the vertex that gets new id i
+    int *order;
+    if (ordering == ORDER_RCM) {
+        int *starts = by_degree(degrees, n_nodes, 0);
+        order = bfs_order(g, starts, degrees);
+        free(starts);
+        for (int i = 0; i < n_nodes / 2; i++) {
+            int t = order[i];
+            order[i] = order[n_nodes - 1 - i];
+            order[n_nodes - 1 - i] = t;
+        }
+    } else if (ordering == ORDER_BFS) {
+        // the destination first, then whatever it doesn't reach in id order
+        int *starts = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+        for (int v = 0; v < n_nodes; v++) {
+            starts[v] = v;
+        }
+        if (n_nodes > 0) {
+            starts[0] = root;
+            starts[root] = 0;
+        }
+        order = bfs_order(g, starts, NULL);
+        free(starts);
+    } else if (ordering == ORDER_DEGREE) {
+        order = by_degree(degrees, n_nodes, 1);
+    } else {
+        order = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+        for (int v = 0; v < n_nodes; v++) {
+            order[v] = v;
+        }
+        if (ordering == ORDER_HUB) {
+            unsigned long total = 0;
+            for (int v = 0; v < n_nodes; v++) {
+                total += degrees[v];
+            }
+            int i = 0;
+            for (int v = 0; v < n_nodes; v++) {
+                if (degrees[v] * n_nodes > total) {
+                    order[i++] = v;
+                }
+            }
+            for (int v = 0; v < n_nodes; v++) {
+                if (degrees[v] * n_nodes <= total) {
+                    order[i++] = v;
+                }
+            }
+        }
+    }
+
+    int *perm = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    for (int i = 0; i < n_nodes; i++) {
+        perm[order[i]] = i;
+    }
+    free(order);
+    free(degrees);
+    return perm;
+}
+
+Graph *graph_permute(Graph *g, int *perm) {
+    Edge *edges = malloc((g->n_edges ? g->n_edges : 1) * sizeof(Edge));
+    unsigned long i = 0;
+    for (int r = 0; r < g->n_rows; r++) {
+        EdgeIter it;
+        graph_out_iter(g, r, &it);
+        int v;
+        WEIGHT w;
+        while (edge_iter_next(&it, &v, &w)) {
+            Edge edge = {perm[r], perm[v], w};
+            edges[i++] = edge;
+        }
+    }
+    Graph *permuted = graph_from_edges(g->n_rows, g->n_cols, edges, g->n_edges);
+    free(edges);
+    return permuted;
+}
+
+void reorder_unmap(int *perm, int n_nodes, WEIGHT *distances, int *next_hops) {
+    WEIGHT *new_distances = malloc((n_nodes ? n_nodes : 1) * sizeof(WEIGHT));
+    int *new_next_hops = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    memcpy(new_distances, distances, n_nodes * sizeof(WEIGHT));
+    memcpy(new_next_hops, next_hops, n_nodes * sizeof(int));
+
+    int *inverse = malloc((n_nodes ? n_nodes : 1) * sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        inverse[perm[v]] = v;
+    }
+    for (int v = 0; v < n_nodes; v++) {
+        distances[v] = new_distances[perm[v]];
+        int hop = new_next_hops[perm[v]];
+        next_hops[v] = hop == -1 ? -1 : inverse[hop];
+    }
+    free(inverse);
+    free(new_distances);
+    free(new_next_hops);
+}
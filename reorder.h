@@ -0,0 +1,32 @@
+#ifndef __REORDER_H__
+#define __REORDER_H__
+
+#include "graph.h"
+
+// vertex relabelings that put vertices which are used together close together
+// in memory, so relaxations walk distances[] in order instead of jumping
+// around it. Neighbors are taken in both directions.
+typedef enum {
+    ORDER_NONE,     // keep the original ids
+    ORDER_RCM,      // reverse Cuthill-McKee, a bfs from low degree vertices, reversed
+    ORDER_BFS,      // bfs order from the destination
+    ORDER_DEGREE,   // highest (in + out) degree first
+    ORDER_HUB,      // hub clustering: above average degree vertices first, both halves keep their order
+    N_ORDERINGS
+} ORDERING;
+
+// picks the ordering from the ORDERING environment variable
+// (none, rcm, bfs, degree or hub). Defaults to none
+ORDERING ordering_from_env();
+const char *ordering_name(ORDERING ordering);
+
+// returns perm with perm[old id] = new id. root is where the bfs ordering starts
+int *reorder_permutation(Graph *g, ORDERING ordering, int root);
+
+// a copy of g with every vertex v renamed to perm[v]. Builds the reverse index
+Graph *graph_permute(Graph *g, int *perm);
+
+// takes results computed on the permuted graph back to the original ids, in place
+void reorder_unmap(int *perm, int n_nodes, WEIGHT *distances, int *next_hops);
+
+#endif
@@ -0,0 +1,119 @@
+// runs the serial engines on every vertex ordering (see reorder.h) of the
+// same graph and reports the time and cache misses against the original ids
+#include "benchmarks.h"
+#include "reorder.h"
+#include "perf_counter.h"
+
+typedef struct {
+    double time;
+    long long misses;
+} Run;
+
+typedef int (*ENGINE)(Graph *graph, int n_nodes, unsigned long n_edges, int src, WEIGHT *distances, int *next_hops);
+
+static Run run_engine(ENGINE engine, Graph *graph, int n_nodes, unsigned long n_edges, int dest,
+        WEIGHT *distances, int *next_hops, PerfCounter *pc) {
+    double start_wall, end_wall, cpu;
+    Run run;
+    timing(&start_wall, &cpu);
+    perf_counter_start(pc);
+    engine(graph, n_nodes, n_edges, dest, distances, next_hops);
+    perf_counter_stop(pc);
+    timing(&end_wall, &cpu);
+    run.time = end_wall - start_wall;
+    run.misses = pc->value;
+    return run;
+}
+
+static void print_run(const char *engine, Run run, Run base) {
+    printf("  %-9s time %9.4f (%5.2fx)", engine, run.time, run.time > 0 ? base.time / run.time : 0);
+    if (run.misses >= 0 && base.misses >= 0) {
+        printf("  cache misses %12lld (%5.2fx fewer)", run.misses, run.misses > 0 ? (double) base.misses / run.misses : 0);
+    } else {
+        printf("  cache misses n/a");
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    double start_wall, end_wall, cpu;
+
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: reorder_bench [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
+        exit(1);
+    }
+
+    debug_init();
+
+    Graph *graph = load_graph(graph_file, n_nodes, n_edges, max_weight);
+    if (graph == NULL) {
+        exit(1);
+    }
+
+    PerfCounter pc;
+    perf_counter_open(&pc, COUNTER_CACHE_MISSES);
+    if (pc.fd == -1) {
+        printf("WARNING: can't open the cache miss counter, only timing\n");
+    }
+
+    // the original ids give the baseline and the answers to check against
+    WEIGHT *base_distances = calloc(n_nodes, sizeof(WEIGHT));
+    WEIGHT *distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *next_hops = calloc(n_nodes, sizeof(int));
+    Run base_dijkstra, base_bf;
+
+    for (ORDERING o = ORDER_NONE; o < N_ORDERINGS; o++) {
+        Graph *g = graph;
+        int *perm = NULL;
+        int dest = 0;
+        double reorder_time = 0;
+        if (o != ORDER_NONE) {
+            timing(&start_wall, &cpu);
+            perm = reorder_permutation(graph, o, dest);
+            g = graph_permute(graph, perm);
+            dest = perm[dest];
+            timing(&end_wall, &cpu);
+            reorder_time = end_wall - start_wall;
+        }
+        printf("%s (reordering %.4f s)\n", ordering_name(o), reorder_time);
+
+        Run dijkstra = run_engine(serial_dijkstra, g, n_nodes, n_edges, dest, distances, next_hops, &pc);
+        if (perm != NULL) {
+            reorder_unmap(perm, n_nodes, distances, next_hops);
+        }
+        if (o == ORDER_NONE) {
+            base_dijkstra = dijkstra;
+            memcpy(base_distances, distances, n_nodes * sizeof(WEIGHT));
+        } else if (memcmp(base_distances, distances, n_nodes * sizeof(WEIGHT)) != 0) {
+            printf("  distances differ from the original ordering!\n");
+        }
+        print_run("dijkstra", dijkstra, base_dijkstra);
+
+        Run bf = run_engine(serial_bellman_ford, g, n_nodes, n_edges, dest, distances, next_hops, &pc);
+        if (perm != NULL) {
+            reorder_unmap(perm, n_nodes, distances, next_hops);
+        }
+        if (o == ORDER_NONE) {
+            base_bf = bf;
+        } else if (memcmp(base_distances, distances, n_nodes * sizeof(WEIGHT)) != 0) {
+            printf("  distances differ from the original ordering!\n");
+        }
+        print_run("bf", bf, base_bf);
+
+        if (perm != NULL) {
+            graph_free(g);
+            free(perm);
+        }
+    }
+
+    perf_counter_close(&pc);
+    free(base_distances);
+    free(distances);
+    free(next_hops);
+    graph_free(graph);
+    return 0;
+}
@@ -1,32 +1,29 @@
 #include "resultr.h"
+#include "graph_file.h"
+#include "generators.h"
 
 // don't think we need more than that
-int KEY_LEN = 64;
-const char *dist_fmt = "%d ";
+int KEY_LEN = 128;
+const char *dist_fmt = "%" WEIGHT_FMT " ";
 const char *pred_fmt = "%d ";
 
-static int get_filename(char *buf, int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo) {
-    return sprintf(buf, "./results/%d_%d_%d_%d_%d.results", n_nodes, n_edges, max_weight, seed, algo);
+// uniform graphs keep their old names, the other models get tagged
+static const char *model_tag() {
+    GRAPH_MODEL model = graph_model_from_env();
+    return model == MODEL_UNIFORM ? "" : graph_model_name(model);
 }
 
-static int get_matrix_filename(char *buf, int seed, int n_nodes, int n_edges, int max_weight) {
-    return sprintf(buf, "./results/%d_%d_%d_%d.matrix", n_nodes, n_edges, max_weight, seed);
+static int get_filename(char *buf, int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo) {
+    const char *tag = model_tag();
+    return sprintf(buf, "./results/%d_%lu_%d_%d%s%s_%d.results", n_nodes, n_edges, max_weight, seed,
+            *tag ? "_" : "", tag, algo);
 }
 
-static int matrix_to_file(char *filename, FlatMatrix *fm) {
-    FILE *fp = fopen(filename, "w+");
-    if (fp == NULL) {
-        printf("Could not open file %s\n", filename);
-        return -1;
-    }
-    for (int r = 0; r < fm->height; r++) {
-        for (int c = 0; c < fm->width; c++) {
-            fprintf(fp, "%3d ", flat_matrix_get(fm, r, c));
-        }
-        fprintf(fp, "\n");
-    }
-    fclose(fp);
-    return 0;
+// graph files are only readable by builds with the same WEIGHT, so keep them apart
+static int get_graph_filename(char *buf, int seed, int n_nodes, unsigned long n_edges, int max_weight) {
+    const char *tag = model_tag();
+    return sprintf(buf, "./results/%d_%lu_%d_%d%s%s%s.graph", n_nodes, n_edges, max_weight, seed,
+            *tag ? "_" : "", tag, sizeof(WEIGHT) == 8 ? "_w64" : "");
 }
 
 static int results_to_file(char *filename, int n_nodes, WEIGHT *distances, int *predecessors) {
@@ -49,7 +46,7 @@ static int results_to_file(char *filename, int n_nodes, WEIGHT *distances, int *
 }
 
 // does not override the existing result file
-int store_result_soft(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors) {
+int store_result_soft(int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors) {
     char buf[KEY_LEN];
     if (get_filename(buf, seed, n_nodes, n_edges, max_weight, algo) == -1) {
         printf("Error generating filename!\n");
@@ -69,7 +66,7 @@ int store_result_soft(int seed, int n_nodes, int n_edges, int max_weight, ALGORI
 }
 
 
-int store_result_hard(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors) {
+int store_result_hard(int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors) {
     char buf[KEY_LEN];
     if (get_filename(buf, seed, n_nodes, n_edges, max_weight, algo) == -1) {
         printf("ERROR generating filename\n");
@@ -79,7 +76,7 @@ int store_result_hard(int seed, int n_nodes, int n_edges, int max_weight, ALGORI
 }
 
 // here, distances and predecessors will be output buffers
-int read_result(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors) {
+int read_result(int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors) {
     char buf[KEY_LEN];
     if (get_filename(buf, seed, n_nodes, n_edges, max_weight, algo) == -1) {
         printf("ERROR generating filename\n");
@@ -104,10 +101,10 @@ int read_result(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM al
     return 1;
 }
 
-// does not override the existing result file
-int store_matrix_soft(int seed, int n_nodes, int n_edges, int max_weight, FlatMatrix *fm) {
+// does not override the existing graph file
+int store_graph_soft(int seed, int n_nodes, unsigned long n_edges, int max_weight, Graph *g) {
     char buf[KEY_LEN];
-    if (get_matrix_filename(buf, seed, n_nodes, n_edges, max_weight) == -1) {
+    if (get_graph_filename(buf, seed, n_nodes, n_edges, max_weight) == -1) {
         printf("Error generating filename!\n");
         return -1;
     }
@@ -117,9 +114,23 @@ int store_matrix_soft(int seed, int n_nodes, int n_edges, int max_weight, FlatMa
     struct stat fstat;
     if (stat(buf, &fstat) == -1) {
         // then the file doesn't exist and we are free to write to it
-        return matrix_to_file(buf, fm);
+        return graph_file_write(buf, g);
     } else {
         printf("File %s already exists!\n", buf);
         return -1;
     }
 }
+
+Graph *read_graph(int seed, int n_nodes, unsigned long n_edges, int max_weight) {
+    char buf[KEY_LEN];
+    if (get_graph_filename(buf, seed, n_nodes, n_edges, max_weight) == -1) {
+        printf("ERROR generating filename\n");
+        return NULL;
+    }
+    // not having stored this graph yet is fine, so don't complain about it
+    struct stat fstat;
+    if (stat(buf, &fstat) == -1) {
+        return NULL;
+    }
+    return graph_file_map(buf);
+}
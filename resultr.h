@@ -8,6 +8,7 @@
 #include <sys/types.h>
 
 #include "flat_matrix.h"
+#include "graph.h"
 
 typedef enum {
     ALGO_SER_DIJKSTRA,
@@ -15,12 +16,17 @@ typedef enum {
     ALGO_PAR_DIJKSTRA,
     ALGO_ASYNC_BF,
     ALGO_SYNC_BF,
+    ALGO_DELTA_STEPPING,
+    ALGO_MPI_DELTA_STEPPING,
+    ALGO_OMP_BF,
 } ALGORITHM;
 
 
-int read_result(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors);
-int store_result_soft(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors);
-int store_result_hard(int seed, int n_nodes, int n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors);
-int store_matrix_soft(int seed, int n_nodes, int n_edges, int max_weight, FlatMatrix *fm);
+int read_result(int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors);
+int store_result_soft(int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors);
+int store_result_hard(int seed, int n_nodes, unsigned long n_edges, int max_weight, ALGORITHM algo, WEIGHT *distances, int *predecessors);
+int store_graph_soft(int seed, int n_nodes, unsigned long n_edges, int max_weight, Graph *g);
+// maps a graph stored by store_graph_soft. Returns NULL if there is none
+Graph *read_graph(int seed, int n_nodes, unsigned long n_edges, int max_weight);
 
 #endif
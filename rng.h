@@ -0,0 +1,40 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+// counter based random numbers: every draw is a pure function of
+// (seed, stream, counter), so any proc or thread can reproduce any part of a
+// random stream without generating what comes before it
+
+// splitmix64 finalizer
+static inline unsigned long long mix64(unsigned long long x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline unsigned long long rng_at(unsigned long long seed, unsigned long long stream, unsigned long long counter) {
+    return mix64(mix64(seed ^ mix64(stream)) ^ counter);
+}
+
+// uniform in [0, 1)
+static inline double rng_unit(unsigned long long x) {
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// uniform in [0, n) for n < 2^32, without the modulo bias: Lemire's
+// multiply-shift, where the few draws that would skew it (about n / 2^32 of
+// them) are rejected and redrawn from mix64(x), so it stays a pure function
+static inline unsigned long rng_below(unsigned long long x, unsigned long n) {
+    unsigned long long m = (x >> 32) * n;
+    if ((m & 0xffffffffULL) < n) {
+        unsigned long long t = (0x100000000ULL - n) % n;   // 2^32 mod n
+        while ((m & 0xffffffffULL) < t) {
+            x = mix64(x);
+            m = (x >> 32) * n;
+        }
+    }
+    return (unsigned long) (m >> 32);
+}
+
+#endif
@@ -1,6 +1,8 @@
 // main file for serial versions
 #include "benchmarks.h"
 #include "resultr.h"
+#include "reorder.h"
+#include "bf_kernel.h"
 
 // function declarations
 void print_path(int *predecessors, int idx);
@@ -9,23 +11,42 @@ int main(int argc, char **argv) {
 
     double start_wall, end_wall, cpu;
 
-    // arguments we need are the number of nodes and number of edges
-    if (argc != 4) {
-        printf("Usage: serial [n_nodes] [n_edges] [max_weight]\n");
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: serial [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
         exit(1);
     }
 
     debug_init();
 
-    int n_nodes = atoi(argv[1]);
-    unsigned long n_edges = atoi(argv[2]);
-    int max_weight = atoi(argv[3]);
-
-    FlatMatrix *adj_matrix = gen_graph(n_nodes, n_edges, max_weight);
-    if (adj_matrix == NULL) {
+    Graph *graph = load_graph(graph_file, n_nodes, n_edges, max_weight);
+    if (graph == NULL) {
         exit(1);
     }
 
+    // relabel the vertices for locality if ORDERING asks for it. Everything
+    // below runs on the new ids and the results get mapped back before storing
+    ORDERING ordering = ordering_from_env();
+    int *perm = NULL;
+    int dest = 0;
+    if (ordering != ORDER_NONE) {
+        timing(&start_wall, &cpu);
+        perm = reorder_permutation(graph, ordering, dest);
+        Graph *permuted = graph_permute(graph, perm);
+        graph_free(graph);
+        graph = permuted;
+        dest = perm[dest];
+        timing(&end_wall, &cpu);
+        printf("Reordering (%s) time: %.4f\n", ordering_name(ordering), end_wall - start_wall);
+    }
+
+    // GRAPH_STORAGE=packed runs the engines on the varint packed graph
+    graph = pack_graph_if_asked(graph);
+
     //flat_matrix_print(adj_matrix);
 
 
@@ -46,34 +67,77 @@ int main(int argc, char **argv) {
 
 
     timing(&start_wall, &cpu);
-    serial_dijkstra(adj_matrix,
+    serial_dijkstra(graph,
                     n_nodes,
                     n_edges,
-                    0,
+                    dest,
                     dijkstra_distances,
                     dijkstra_predecessors);
 
     timing(&end_wall, &cpu);
     printf("Dijkstra's time: %.4f\n", end_wall - start_wall);
 
+    // same thing without decrease-key, only kept to compare against
+    WEIGHT *lazy_distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *lazy_next_hops = calloc(n_nodes, sizeof(int));
+    timing(&start_wall, &cpu);
+    serial_dijkstra_lazy(graph, n_nodes, n_edges, dest, lazy_distances, lazy_next_hops);
+    timing(&end_wall, &cpu);
+    printf("Lazy Dijkstra's time: %.4f\n", end_wall - start_wall);
+    if (memcmp(lazy_distances, dijkstra_distances, n_nodes * sizeof(WEIGHT)) != 0) {
+        printf("Lazy Dijkstra disagrees with Dijkstra! L2 norm %lf\n", l2_norm(lazy_distances, dijkstra_distances, n_nodes));
+    }
+    free(lazy_distances);
+    free(lazy_next_hops);
+
     WEIGHT *bf_distances = calloc(n_nodes, sizeof(WEIGHT));
 
     timing(&start_wall, &cpu);
-    serial_bellman_ford(adj_matrix,
+    int bf_rounds = serial_bellman_ford(graph,
                     n_nodes,
                     n_edges,
-                    0,
+                    dest,
                     bf_distances,
                     bf_predecessors);
 
     timing(&end_wall, &cpu);
-    printf("BF's time: %.4f\n", end_wall - start_wall);
+    printf("BF's time: %.4f (%d rounds, %s kernel)\n", end_wall - start_wall, bf_rounds, bf_kernel_name(bf_kernel_pick()));
+    if (bf_rounds == -1) {
+        printf("BF found a negative cycle!\n");
+    }
+
+    // the worklist and Yen versions, only kept to compare against
+    WEIGHT *other_distances = calloc(n_nodes, sizeof(WEIGHT));
+    int *other_next_hops = calloc(n_nodes, sizeof(int));
+    timing(&start_wall, &cpu);
+    int queue_pops = serial_bellman_ford_queue(graph, n_nodes, n_edges, dest, other_distances, other_next_hops);
+    timing(&end_wall, &cpu);
+    printf("Queue BF's time: %.4f (%d pops)\n", end_wall - start_wall, queue_pops);
+    if ((queue_pops == -1) != (bf_rounds == -1)
+            || (bf_rounds != -1 && memcmp(other_distances, bf_distances, n_nodes * sizeof(WEIGHT)) != 0)) {
+        printf("Queue BF disagrees with BF!\n");
+    }
+    timing(&start_wall, &cpu);
+    int yen_pairs = serial_bellman_ford_yen(graph, n_nodes, n_edges, dest, other_distances, other_next_hops);
+    timing(&end_wall, &cpu);
+    printf("Yen BF's time: %.4f (%d pass pairs)\n", end_wall - start_wall, yen_pairs);
+    if ((yen_pairs == -1) != (bf_rounds == -1)
+            || (bf_rounds != -1 && memcmp(other_distances, bf_distances, n_nodes * sizeof(WEIGHT)) != 0)) {
+        printf("Yen BF disagrees with BF!\n");
+    }
+    free(other_distances);
+    free(other_next_hops);
+
+    if (perm != NULL) {
+        reorder_unmap(perm, n_nodes, dijkstra_distances, dijkstra_predecessors);
+        reorder_unmap(perm, n_nodes, bf_distances, bf_predecessors);
+    }
 
     // make sure they're the same!
     // TODO: replace this with a norm
     for (int i = 0; i < n_nodes; i++) {
         if (bf_distances[i] != dijkstra_distances[i]) {
-            printf("Disagreement at index %d! Dijkstras %d BF %d\n", i, dijkstra_distances[i], bf_distances[i]);
+            printf("Disagreement at index %d! Dijkstras %" WEIGHT_FMT " BF %" WEIGHT_FMT "\n", i, dijkstra_distances[i], bf_distances[i]);
             printf("\tDijkstra's path:\n\t\t");
             print_path(dijkstra_predecessors, i);
             printf("\n\tBF's path:\n\t\t");
@@ -96,7 +160,8 @@ int main(int argc, char **argv) {
     free(bf_predecessors);
     free(dijkstra_distances);
     free(bf_distances);
-    flat_matrix_free(adj_matrix);
+    graph_free(graph);
+    free(perm);
 
     return 0;
 }
@@ -1,21 +1,17 @@
-#define _BSD_SOURCE
 #include <stdio.h>
 #include <limits.h>
 #include <mpi.h>
 #include <string.h>
-#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "helpers.h"
 #include "benchmarks.h"
 #include "resultr.h"
+#include "graph_mpi.h"
+#include "offers.h"
 
-#define ITERATIONS_TO_CONVERGE 20
-
-
-enum MPI_TAG {
-    TAG_KEY,
-    TAG_VAL
-};
 
 static void pprintf(const char *fmt, ...) {
     va_list args;
@@ -26,86 +22,55 @@ static void pprintf(const char *fmt, ...) {
     vprintf(fmt, args);
 }
 
-static int node_to_proc(int node, int nodes_per_proc) {
-    return (node / nodes_per_proc);
-}
-
-static int get_tag(int src_node, int dest_node, int n_nodes, int nodes_per_proc) {
-    int src_v = src_node % nodes_per_proc;
-    int dst_v = dest_node % nodes_per_proc;
-    return src_v + nodes_per_proc * dst_v;
-}
-
-MQNode DUMMY = {-1, -1, -1};
-
-int sync_bf(FlatMatrix *adj_matrix, int n_nodes, int n_edges, int src, WEIGHT *distances, int *next_hops);
+int sync_bf(Graph *in_graph, Partition *part, int n_nodes, int src, WEIGHT *distances, int *next_hops);
 
 int main(int argc, char **argv) {
 
     double start_wall, end_wall, cpu;
 
-    MPI_Init(&argc, &argv);
+    mpi_init_threads(&argc, &argv);
 
-    // arguments we need are the number of nodes and number of edges
-    if (argc != 4) {
-        printf("Usage: serial [n_nodes] [n_edges] [max_weight]\n");
+    // arguments we need are the number of nodes and number of edges, or a graph file
+    int n_nodes;
+    unsigned long n_edges;
+    int max_weight;
+    char *graph_file;
+    if (parse_graph_args(argc, argv, &graph_file, &n_nodes, &n_edges, &max_weight) == -1) {
+        printf("Usage: serial [n_nodes] [n_edges] [max_weight] | [graph_file]\n");
         exit(1);
     }
 
     debug_init();
 
-    int n_nodes = atoi(argv[1]);
-    unsigned long n_edges = atoi(argv[2]);
-    int max_weight = atoi(argv[3]);
-
-    FlatMatrix *adj_matrix;
     int rank, n_procs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
 
-    // master proc should split the graph up and distribute to each node
+    // no proc holds the whole graph: each one loads its own rows and gets the
+    // in edges of its own nodes from the others
     // also each proc should have their own version of distances[] and next_hops[]
 
-    // now we get our cluster.
-    // ASSUME that num_procs | n_nodes
-    int nodes_per_proc = n_nodes / n_procs;
-    // each node will have a matrix with nodes_per_proc rows and n_nodes cols
-    FlatMatrix *per_node_matrix = flat_matrix_init(n_nodes, nodes_per_proc);
     // global distances and global next_hops for gathering
     WEIGHT *global_distances = NULL;
     int *global_next_hops = NULL;
 
-    pprintf("About to have master generate stuff\n");
-    // the master proc will generate the graph
+    // master proc only needs room to gather the results
     if (rank == 0) {
         // allocate global distances and next_hops
         global_distances = calloc(n_nodes, sizeof(WEIGHT));
         global_next_hops = calloc(n_nodes, sizeof(int));
-
-
-        adj_matrix = gen_graph(n_nodes, n_edges, max_weight);
-        if (adj_matrix == NULL) {
-            exit(1);
-        }
-
-        //flat_matrix_print(adj_matrix);
-        /*for (int i = 0; i < n_nodes * n_nodes; i++) {*/
-            /*printf("%d ", adj_matrix->arr[i]);*/
-        /*}*/
-    } else {
-        adj_matrix = flat_matrix_init(n_nodes, n_nodes);
     }
 
-    // here we will just broadcast, since we need to know eaach node's neighbors in both directions
-    int bcast_res = MPI_Bcast(
-            adj_matrix->arr,
-            n_nodes * n_nodes,
-            MPI_INT,
-            0,
-            MPI_COMM_WORLD);
-    if (bcast_res) {
-        pprintf("Error when broadcasting!\n");
+    // we need to know each node's neighbors in both directions: the out edges
+    // are our own rows, the in edges come from everyone else's rows
+    Partition *part;
+    Graph *graph = graph_load_partitioned(graph_file, n_nodes, n_edges, max_weight, &part, MPI_COMM_WORLD);
+    if (graph == NULL) {
+        exit(1);
     }
+    Graph *in_graph = graph_in_edges(graph, part, MPI_COMM_WORLD);
+    // the engine only reads the in edges, through edge iterators, so pack them if asked
+    in_graph = graph_pack_if_asked(in_graph, MPI_COMM_WORLD);
 
     // function signatures should look like
     // int shortest_path(adj_matrix, n_nodes, source, WEIGHT *distances, int **paths)
@@ -118,25 +83,25 @@ int main(int argc, char **argv) {
     //print_array(adj_matrix, n_nodes);
 
     // each node has its own next_hops and distances arrays
-    int *sync_bf_next_hops = calloc(nodes_per_proc, sizeof(int));
+    int *sync_bf_next_hops = calloc(part->n_local ? part->n_local : 1, sizeof(int));
 
-    WEIGHT *sync_bf_distances = calloc(nodes_per_proc, sizeof(WEIGHT));
+    WEIGHT *sync_bf_distances = calloc(part->n_local ? part->n_local : 1, sizeof(WEIGHT));
 
 
     timing(&start_wall, &cpu);
-    sync_bf(adj_matrix,
+    int rounds = sync_bf(in_graph,
+                    part,
                     n_nodes,
-                    n_edges,
                     0,
                     sync_bf_distances,
                     sync_bf_next_hops);
 
     timing(&end_wall, &cpu);
-    pprintf("sync BF's time: %.4f\n", end_wall - start_wall);
+    pprintf("sync BF's time: %.4f (%d rounds)\n", end_wall - start_wall, rounds);
 
-    // now we gather the results
-    MPI_Gather(sync_bf_distances, nodes_per_proc, MPI_INT, global_distances, nodes_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Gather(sync_bf_next_hops, nodes_per_proc, MPI_INT, global_next_hops, nodes_per_proc, MPI_INT, 0, MPI_COMM_WORLD);
+    // now we gather the results back into global order
+    partition_gather(part, sync_bf_distances, global_distances, MPI_WEIGHT, 0, MPI_COMM_WORLD);
+    partition_gather(part, sync_bf_next_hops, global_next_hops, MPI_INT, 0, MPI_COMM_WORLD);
 
     // for comparison, get results from serial dijsktra
     if (rank == 0) {
@@ -152,8 +117,8 @@ int main(int argc, char **argv) {
         if (res == -1) {
             pprintf("Could not read past result!\n");
         } else {
-            //double l2 = l2_norm(global_distances, ser_distances, n_nodes);
-            //printf("L2 norm with serial BF: %lf\n", l2);
+            double l2 = l2_norm(global_distances, ser_distances, n_nodes);
+            printf("L2 norm with serial dijkstra: %lf\n", l2);
 
             /*// and now we have the global distances!*/
             /*pprintf("DIJKSTRA DISTANCES!\n");*/
@@ -182,302 +147,123 @@ int main(int argc, char **argv) {
     free(sync_bf_distances);
     /*free(serial_distances);*/
     if (rank == 0) {
-        flat_matrix_free(adj_matrix);
         free(global_distances);
         free(global_next_hops);
     }
-    flat_matrix_free(per_node_matrix);
+    graph_free(graph);
+    graph_free(in_graph);
+    partition_free(part);
 
     MPI_Finalize();
 
     return 0;
 }
 
-int sync_bf(FlatMatrix *adj_matrix, int n_nodes, int n_edges, int dest, WEIGHT *distances, int *next_hops) {
+int sync_bf(Graph *in_graph, Partition *part, int n_nodes, int dest, WEIGHT *distances, int *next_hops) {
 
     // general workflow:
-    // If a node has n neighbors, then we essentially keep n "receives" open, one for each neighbor.
-    // Read those receives. If there is something in one of them, read it and reopen the receive
-    //  EAch receive essentially is an updated estimate. Then we recalculate our value and send() to all neighbors
-    // If we don't have an update in n loops, then we assume termiantion and just return.
+    // Every round, each node whose distance changed in the last round offers
+    // its in neighbors (upstream) their distance through it: its own
+    // distance plus the edge. The offers are (local row on the owner, via,
+    // distance), and all of them, ours included, go out in a single
+    // all-to-all (counts, then payload). Each proc then applies what it got,
+    // and the nodes that got better are the ones that send next round.
+    //
+    // Within a proc the OpenMP threads split the changed nodes, each writing
+    // its offers to its own list, and the received offers are applied by all
+    // of them through an OfferTable (see offers.h). MPI is only called
+    // between the parallel loops, from the master thread.
     //
     // In general, each node waits for updates from their out_neighbors (downstream), and sends updates to their
     // in_neighbors (upstream)
 
-    // a dummy mpi_request
-    //
-
     int rank, n_procs;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &n_procs);
 
-    // now we get our cluster.
-    // ASSUME that num_procs | n_nodes
-    int nodes_per_proc = n_nodes / n_procs;
-    int offset = nodes_per_proc * rank;
-
-    // initialize all the distances to infinity
-    for (int i = 0; i < nodes_per_proc; i++) {
-        if (offset + i == dest) {
-            pprintf("Initializing destination node %d\n", offset + i);
-            distances[i] = 0;
-            next_hops[i] = -1;
-        } else {
-            distances[i] = INT_MAX;
-            next_hops[i] = -1;
-        }
-    }
-
-    int *n_in_neighbors = calloc(nodes_per_proc, sizeof(int));
-    int *n_out_neighbors = calloc(nodes_per_proc, sizeof(int));
-    for (int v = 0; v < nodes_per_proc; v++) {
-        // figure out how many neighbors each node has
-        // in neighbors of node v are at arr[i][v]
-        for (int i = 0; i < n_nodes; i++) {
-            // check if i is an in neighbor
-            if (flat_matrix_get(adj_matrix, i, v + offset)) {
-                n_in_neighbors[v]++;
-            }
-            if (flat_matrix_get(adj_matrix, v + offset, i)) {
-                n_out_neighbors[v]++;
-            }
-        }
-    }
-
-    // each node has global estimates
-    /*WEIGHT **estimates = calloc(nodes_per_proc, sizeof(WEIGHT *));*/
-
-
-    int **in_neighbors = calloc(nodes_per_proc, sizeof(int *));
-    int **out_neighbors = calloc(nodes_per_proc, sizeof(int *));
-
-    // for each node, we will also have a "new neighbor estimate array"
-    // that holds any updated estimates from OUT_NEIGHBORS
-    WEIGHT **downstream_updates = calloc(nodes_per_proc, sizeof(WEIGHT *));
-
-    WEIGHT **intraproc_updates = calloc(nodes_per_proc, sizeof(WEIGHT *));
+    // our cluster: row v of the graph is global node part->local_nodes[v]
+    int n_local = part->n_local;
 
-    // populate the neighbor arrays and such
-    for (int v = 0; v < nodes_per_proc; v++) {
-        // allocate the list
-        in_neighbors[v] = calloc(n_in_neighbors[v], sizeof(int));
-        out_neighbors[v] = calloc(n_out_neighbors[v], sizeof(int));
-        downstream_updates[v] = calloc(n_out_neighbors[v], sizeof(WEIGHT));
-        intraproc_updates[v] = calloc(nodes_per_proc, sizeof(WEIGHT));
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
 
-        int in_idx = 0;
-        int out_idx = 0;
-        for (int i = 0; i < n_nodes; i++) {
-            // check if i is an in neighbor
-            if (flat_matrix_get(adj_matrix, i, v + offset)) {
-                in_neighbors[v][in_idx] = i;
-                in_idx++;
-            }
-            if (flat_matrix_get(adj_matrix, v + offset, i)) {
-                out_neighbors[v][out_idx] = i;
-                out_idx++;
-            }
-        }
+    // initialize all the distances to infinity
+    for (int i = 0; i < n_local; i++) {
+        distances[i] = WEIGHT_MAX;
+        next_hops[i] = -1;
     }
-
-    // send the round 0 updates
-    for (int v = 0; v < nodes_per_proc; v++) {
-        for (int i = 0; i < n_in_neighbors[v]; i++) {
-            int n = in_neighbors[v][i];
-            int proc = n / nodes_per_proc;
-
-            // don't need to send to ourselves, just write to the array!
-            if (proc == rank) {
-                int dest_v = n % nodes_per_proc;
-                intraproc_updates[v][dest_v] = distances[v];
-                continue;
-            }
-
-            // send an upate to each one of the in neighbors with tag given by
-            int tag = get_tag(v + offset, n, n_nodes, nodes_per_proc);
-            MPI_Request req;
-            //pprintf("proc is %d (n, nodespp) %d %d \n", proc, n, nodes_per_proc);
-            MPI_Isend(&(distances[v]), 1, MPI_INT, proc, tag, MPI_COMM_WORLD, &req);
-            MPI_Request_free(&req);
-        }
+    OfferTable *table = offers_init(n_local, distances, next_hops);
+
+    // the nodes that send this round
+    int *active = malloc((n_local ? n_local : 1) * sizeof(int));
+    long n_active = 0;
+    if (part->owner[dest] == rank) {
+        pprintf("Initializing destination node %d\n", dest);
+        Edge init = {part->local_idx[dest], -1, 0};
+        offers_apply(table, &init, 1);
+        memcpy(active, table->improved, table->n_improved * sizeof(int));
+        n_active = table->n_improved;
     }
 
-    for (int round = 1; round <= n_nodes; round++) {
-        /*pprintf("Starting round %d\n", round);*/
-        MPI_Barrier(MPI_COMM_WORLD);
-        // wait for the round round-1 updates
-        for (int v = 0; v < nodes_per_proc; v++) {
-            for (int i = 0; i < n_out_neighbors[v]; i++) {
-                int n = out_neighbors[v][i];
-                int proc = n / nodes_per_proc;
-
-                int downstream = -1;
-
-                if (proc == rank) {
-                    int src_v = n % nodes_per_proc;
-                    downstream = intraproc_updates[src_v][v];
-                } else {
-
-                    int tag = get_tag(n, v+offset, n_nodes, nodes_per_proc);
-
-                    MPI_Recv(&downstream, 1, MPI_INT, proc, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    // each thread's offers, then all of this round's
+    OfferList *lists = calloc(n_threads, sizeof(OfferList));
+    OfferList out = {NULL, NULL, 0, 0};
+
+    // a round where nobody changed anything means nobody has anything to
+    // send in the next one either, so one allreduce of the flag ends it
+    unsigned long sent = 0;
+    int round = 0;
+    int any_changed = 1;
+    while (any_changed && round < n_nodes) {
+        round++;
+        #pragma omp parallel
+        {
+            int t = 0;
+#ifdef _OPENMP
+            t = omp_get_thread_num();
+#endif
+            #pragma omp for schedule(dynamic, 64)
+            for (long k = 0; k < n_active; k++) {
+                int v = active[k];
+                int via = part->local_nodes[v];
+                EdgeIter it;
+                graph_out_iter(in_graph, v, &it);
+                int n;
+                WEIGHT w;
+                while (edge_iter_next(&it, &n, &w)) {
+                    WEIGHT alt_dist = weight_add(distances[v], w);
+                    if (alt_dist < WEIGHT_MAX) {
+                        offer_list_push(&lists[t], part->local_idx[n], via, alt_dist, part->owner[n]);
+                    }
                 }
-
-                // now update our estimate
-                WEIGHT edge_weight = flat_matrix_get(adj_matrix, v+offset, n);
-                /*pprintf("Node %d received update %d from node %d\n", v+offset, downstream, n);*/
-                /*pprintf("Node %d candidate update: %d (current distance %d)\n", v + offset, downstream + edge_weight, distances[v]);*/
-                if (downstream != INT_MAX && downstream != -1 && downstream + edge_weight < distances[v]) {
-                    distances[v] = downstream + edge_weight;
-                    next_hops[v] = n;
-                }
-
-            }
-        }
-
-        // send the updates for this round
-        for (int v = 0; v < nodes_per_proc; v++) {
-            for (int i = 0; i < n_in_neighbors[v]; i++) {
-                int n = in_neighbors[v][i];
-                int proc = n / nodes_per_proc;
-
-                // send an upate to each one of the in neighbors with tag given by
-                int tag = get_tag(v + offset, n, n_nodes, nodes_per_proc);
-                MPI_Request req;
-                //printf("proc is %d (n, nodespp) %d %d \n", proc, n, nodes_per_proc);
-                MPI_Isend(&(distances[v]), 1, MPI_INT, proc, tag, MPI_COMM_WORLD, &req);
-                MPI_Request_free(&req);
             }
         }
+        offer_list_merge(&out, lists, n_threads);
+
+        unsigned long n_recv;
+        Edge *recv = graph_exchange_edges(out.edges, out.dests, out.len, &n_recv, MPI_COMM_WORLD);
+        sent += out.len;
+        out.len = 0;
+        n_active = offers_apply(table, recv, n_recv);
+        memcpy(active, table->improved, n_active * sizeof(int));
+        free(recv);
+
+        int my_changed = n_active > 0;
+        MPI_Allreduce(&my_changed, &any_changed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
     }
-
-
-    /*// now we get the actual list of neighbors*/
-    /*for (int v = 0; v < nodes_per_proc; v++) {*/
-        /*// allocate the list*/
-        /*in_neighbors[v] = calloc(n_in_neighbors[v], sizeof(int));*/
-        /*out_neighbors[v] = calloc(n_out_neighbors[v], sizeof(int));*/
-        /*downstream_updates[v] = calloc(n_out_neighbors[v], sizeof(WEIGHT));*/
-
-        /*irecv_reqs[v] = calloc(n_out_neighbors[v], sizeof(MPI_Request));*/
-        /*isend_reqs[v] = calloc(n_in_neighbors[v], sizeof(MPI_Request));*/
-
-        /*int in_idx = 0;*/
-        /*int out_idx = 0;*/
-        /*for (int i = 0; i < n_nodes; i++) {*/
-            /*// check if i is an in neighbor*/
-            /*if (flat_matrix_get(adj_matrix, i, v + offset)) {*/
-                /*in_neighbors[v][in_idx] = i;*/
-                /*isend_reqs[v][in_idx] = calloc(1, sizeof(MPI_Request));*/
-                /*in_idx++;*/
-            /*}*/
-            /*if (flat_matrix_get(adj_matrix, v + offset, i)) {*/
-                /*out_neighbors[v][out_idx] = i;*/
-                /*irecv_reqs[v][out_idx] = calloc(1, sizeof(MPI_Request));*/
-                /*out_idx++;*/
-            /*}*/
-        /*}*/
-    /*}*/
-
-    /*// always have the receive port open, for each neighbor of each node*/
-    /*// the message sent will be their new estimate for distance to the dest*/
-    /*for (int v = 0; v < nodes_per_proc; v++) {*/
-        /*for (int i = 0; i < n_out_neighbors[v]; i++) {*/
-            /*int n = out_neighbors[v][i];*/
-            /*int node = (n / nodes_per_proc);*/
-            /*MPI_Request req = irecv_reqs[v][i];*/
-            /*// n is the neighbor*/
-            /*// i is the index in out_neighbors*/
-
-            /*// alright the tag is gonna be given by*/
-            /*// v * n_nodes + n*/
-            /*int tag = v * n_nodes + n;*/
-            /*// updates from neighbor n to vertex v will go into downstream_updates[v][n];*/
-            /*MPI_Irecv(&(downstream_updates[v][i]), 1, MPI_INT, node, tag, MPI_COMM_WORLD, &req);*/
-        /*}*/
-    /*}*/
-
-    /*// now we can proceed*/
-    /*int static_iters = 0;*/
-    /*// while (static_iters < ITERATIONS_TO_CONVERGE) {*/
-    /*for (int n_iters = 0; n_iters < n_nodes; n_iters++) {*/
-        /*// check for any updates from downstream and*/
-        /*// use them to recompute local values*/
-        /*for (int v = 0; v < nodes_per_proc; v++) {*/
-            /*for (int i = 0; i < n_out_neighbors[v]; i++) {*/
-                /*int n = out_neighbors[v][i];*/
-                /*int proc = (n / nodes_per_proc);*/
-                /*// get the MPI_Request*/
-                /*MPI_Request req = irecv_reqs[v][i];*/
-
-                /*int flag;*/
-                /*MPI_Status status;*/
-                /*MPI_Test(&req, &flag, &status);*/
-
-                /*if (flag) {  // then we have an update*/
-
-                    /*// check the value of the downstream updates*/
-                    /*int new_est = downstream_updates[v][i];*/
-                    /*pprintf("Node %d got update from proc %d node %d (new_est %d)\n", v + offset, proc, n, new_est);*/
-                    /*int edge_weight = flat_matrix_get(adj_matrix, v + offset, n);*/
-                    /*if (new_est != INT_MAX && new_est + edge_weight < distances[v]) {*/
-                        /*distances[v] = new_est + edge_weight;*/
-                        /*next_hops[v] = n;*/
-                        /*has_local_update = 1;*/
-                    /*}*/
-
-                    /*// and now we reopen the irecv*/
-
-                    /*memset(&req, 0, sizeof(MPI_Request));*/
-                    /*int tag = v * n_nodes + n;*/
-                    /*MPI_Irecv(&(downstream_updates[v][i]), 1, MPI_INT, proc, tag, MPI_COMM_WORLD, &req);*/
-                /*}*/
-
-            /*}*/
-
-            /*if (has_local_update) {*/
-                /*static_iters = 0;*/
-                /*for (int i = 0; i < n_in_neighbors[v]; i++) {*/
-                    /*MPI_Request req = isend_reqs[v][i];*/
-                    /*int n = in_neighbors[v][i];*/
-                    /*int proc = (n / nodes_per_proc);*/
-                    /*int tag = v * n_nodes + n;*/
-                    /*pprintf("Node %d sending updated estimate %d to proc %d\n", v + offset, distances[v], proc);*/
-
-                    /*int flag;*/
-                    /*MPI_Status status;*/
-                    /*MPI_Request_get_status(req, &flag, &status);*/
-                    /*if (!flag) pprintf("Past send not complete!\n");*/
-
-                    /*MPI_Isend(&distances[v], 1, MPI_INT, proc, tag, MPI_COMM_WORLD, &req);*/
-                /*}*/
-                /*has_local_update = 0;*/
-            /*} else {*/
-                /*static_iters++;*/
-            /*}*/
-
-        /*}*/
-
-        /*usleep(100000);*/
-        /*MPI_Barrier(MPI_COMM_WORLD);*/
-    /*}*/
-
-    // then we put a barrier here to make sure everyone returns at the same time
-    /*MPI_Barrier(MPI_COMM_WORLD);*/
+    debugf("sent %lu updates\n", sent);
 
     //////////////////////////////////////////////////////////////
     // CLEANUP
     //////////////////////////////////////////////////////////////
-
-    for (int i = 0; i < nodes_per_proc; i++) {
-        free(in_neighbors[i]);
-        free(out_neighbors[i]);
-        free(downstream_updates[i]);
+    for (int t = 0; t < n_threads; t++) {
+        offer_list_free(&lists[t]);
     }
-    free(in_neighbors);
-    free(out_neighbors);
-    free(downstream_updates);
-    free(n_in_neighbors);
-    free(n_out_neighbors);
-
+    free(lists);
+    offer_list_free(&out);
+    offers_free(table);
+    free(active);
+    return round;
 }
@@ -34,15 +34,15 @@ int main(int argc, char **argv) {
 
     printf("popping min\n");
     MQNode *min = mqueue_pop_min(mq);
-    printf("Got (%d %d)\n", min->key, min->val);
+    printf("Got (%d %" WEIGHT_FMT ")\n", min->key, min->val);
 
     printf("popping min\n");
     min = mqueue_pop_min(mq);
-    printf("Got (%d %d)\n", min->key, min->val);
+    printf("Got (%d %" WEIGHT_FMT ")\n", min->key, min->val);
 
     printf("popping min\n");
     min = mqueue_pop_min(mq);
-    printf("Got (%d %d)\n", min->key, min->val);
+    printf("Got (%d %" WEIGHT_FMT ")\n", min->key, min->val);
 
     printf("Inserting (11,1)\n");
     MQNode mqn1 = {11, 1};
@@ -50,8 +50,44 @@ int main(int argc, char **argv) {
 
     printf("popping min\n");
     min = mqueue_pop_min(mq);
-    printf("Got (%d %d)\n", min->key, min->val);
-
+    printf("Got (%d %" WEIGHT_FMT ")\n", min->key, min->val);
 
+    printf("Updating (7,7) to (7,0) and (6,6) to (6,9)\n");
+    mqueue_update_val(mq, &mqn7, 0);
+    mqueue_update_val(mq, &mqn6, 9);
 
+    printf("popping min\n");
+    min = mqueue_pop_min(mq);
+    printf("Got (%d %" WEIGHT_FMT ")\n", min->key, min->val);
+
+    // a bigger run, in and out of order, checking the pops come out sorted
+    int ok = 1;
+    for (MQUEUE_KIND kind = MQUEUE_HEAP; kind <= MQUEUE_DIAL; kind++) {
+        printf("Pushing 1000 keys in scrambled order into a %s, removing 200\n", mqueue_kind_name(kind));
+        mqueue_free(mq);
+        mq = mqueue_init_kind(kind, 1000, 2000);
+        for (int k = 0; k < 1000; k++) {
+            mqueue_push(mq, k, (k * 7919) % 1000 + 1000);
+        }
+        for (int k = 0; k < 1000; k += 3) {
+            mqueue_update_key(mq, k, (k * 104729) % 1000);
+        }
+        for (int k = 0; k < 1000; k += 5) {
+            mqueue_remove(mq, k);
+        }
+        int n_popped = 0, sorted = 1, key;
+        WEIGHT val, last = -1;
+        while (mqueue_pop(mq, &key, &val)) {
+            if (val < last) {
+                sorted = 0;
+            }
+            last = val;
+            n_popped++;
+        }
+        printf("Popped %d, %s\n", n_popped, sorted ? "in order" : "OUT OF ORDER");
+        ok = ok && sorted && n_popped == 800;
+    }
+
+    mqueue_free(mq);
+    return !ok;
 }
@@ -0,0 +1,42 @@
+#ifndef __TYPES_H__
+#define __TYPES_H__
+
+#include <limits.h>
+
+// edge weights and distances. Build with -DWEIGHT_64 for 64-bit distances
+// when long weighted paths could get past INT_MAX. WEIGHT_MAX doubles as
+// "unreachable", so relaxations go through weight_add() to saturate there
+// instead of wrapping around. WEIGHT_FMT is the printf conversion without
+// the %, like the PRI macros: printf("%" WEIGHT_FMT, d)
+#ifdef WEIGHT_64
+#define WEIGHT long long
+#define WEIGHT_MAX LLONG_MAX
+#define WEIGHT_FMT "lld"
+#else
+#define WEIGHT int
+#define WEIGHT_MAX INT_MAX
+#define WEIGHT_FMT "d"
+#endif
+
+// d + w, or WEIGHT_MAX if d is unreachable or the sum would not fit.
+// Only the Bellman-Ford engines can take negative weights
+static inline WEIGHT weight_add(WEIGHT d, WEIGHT w) {
+    if (w > 0 ? d > WEIGHT_MAX - w : d == WEIGHT_MAX) {
+        return WEIGHT_MAX;
+    }
+    return d + w;
+}
+
+// lowers *p to v if v is smaller, returns whether it did. For the engines
+// where several threads relax into the same distances
+static inline int atomic_min_weight(WEIGHT *p, WEIGHT v) {
+    WEIGHT old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (v < old) {
+        if (__atomic_compare_exchange_n(p, &old, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif